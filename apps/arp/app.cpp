@@ -47,7 +47,12 @@ void arp_egress(ap_uint<48> macAddress, ap_uint<32> ipAddress, stream<ap_axiu<W,
 #pragma HLS INTERFACE axis port=arpcache_insert_start
 
     static ArpCacheT arpcache;
+    static bool arpcache_configured = false;
         //#pragma HLS inline all recursive
+    if(!arpcache_configured) {
+        arpcache.set_aging(ARP_AGE_PERIOD, ARP_AGE_TIMEOUT, true);
+        arpcache_configured = true;
+    }
     struct arpcache_insert_args arg;
     if(!arpcache_insert_start.empty()) {
         arg = arpcache_insert_start.read();
@@ -58,6 +63,15 @@ void arp_egress(ap_uint<48> macAddress, ap_uint<32> ipAddress, stream<ap_axiu<W,
         //arpcache_insert_done.write(ret);
     }
     arpcache.sweep();
+    IPAddressT expiredIP;
+    MACAddressT expiredMAC;
+    // An expired entry simply misses on the next lookup, which sends a
+    // new ARP request for the address.
+    if(arpcache.age(expiredIP, expiredMAC)) {
+#ifndef __SYNTHESIS__
+        std::cout << "expired: " << expiredMAC << " " << expiredIP << "\n";
+#endif
+    }
 
     auto reader = make_reader(dataIn);
     auto writer = make_writer(dataOut);
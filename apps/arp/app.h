@@ -29,6 +29,12 @@ const static int W = 64;
 typedef hls::algorithmic_cam<256, 4, IPAddressT, MACAddressT> ArpCacheT;
 //typedef hls::cam<4, IPAddressT, MACAddressT> ArpCacheT;
 
+// ARP cache entries which are not used are evicted after ARP_AGE_TIMEOUT
+// passes of the aging hand.  The hand visits one entry every ARP_AGE_PERIOD
+// calls to arp_egress.
+const static int ARP_AGE_PERIOD = 1024;
+const static int ARP_AGE_TIMEOUT = 8;
+
 struct arpcache_insert_args {
     ap_uint<32> ip;
     ap_uint<48> mac;
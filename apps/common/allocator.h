@@ -46,7 +46,9 @@ public:
         for(int i = 0; i < N-1; i++) {
 #pragma HLS pipeline II=1
             freelist[i] = i+1;
+            allocated[i] = false;
         }
+        allocated[N-1] = false;
         freelist[N-1] = 0;
         freehead = 0;
         allocated_count = 0;
@@ -57,7 +59,9 @@ public:
         for(int i = 0; i < N-1; i++) {
 #pragma HLS pipeline II=1
             freelist[i] = i+1;
+            allocated[i] = false;
         }
+        allocated[N-1] = false;
         freelist[N-1] = 0;
         freehead = 0;
         allocated_count = 0;
@@ -66,6 +70,10 @@ public:
     bool is_allocated(int node) {
         return allocated[node];
     }
+    // Return true if allocate() will succeed.
+    bool canAllocate() {
+        return freelist[freehead] != freehead;
+    }
     int allocate() {
         indexT freenode = freelist[freehead];
         assert(!allocated[freenode]);
@@ -97,6 +105,24 @@ public:
         freelist[freehead] = freenode;
         allocated[freenode] = false;
     }
+    // Deallocate free_id (if it is not negative) and, if allocate_valid is set,
+    // allocate an id, as a single operation.  When both happen, free_id is
+    // reallocated directly, so the free list is not accessed and there is no
+    // hazard between the two.
+    // Return the allocated id, or -1 if no id was allocated.
+    int allocate_and_free(int free_id, bool allocate_valid = true) {
+        if(free_id >= 0 && allocate_valid) {
+            assert(allocated[free_id]);
+            return free_id;
+        } else if(free_id >= 0) {
+            deallocate(free_id);
+            return -1;
+        } else if(allocate_valid) {
+            return allocate();
+        } else {
+            return -1;
+        }
+    }
     int find_allocated() {
         findindex++;
         if(findindex >= allocated_count) {
@@ -131,58 +157,214 @@ std::ostream& operator<<(std::ostream& os, const Allocator<SIZE>& a) {
 }
 
 
-// const static int memorySize = 256;
-// struct PacketInMemory {
-//     ap_uint<BitWidth<memorySize>::Value> index;
-//     ap_uint<BitWidth<MTU>::Value> length;
-// };
-
-// /** @ingroup ip_handler
-//  *  @param[in]		dataIn, incoming data stream
-//  */
-// template <typename PACKET>
-// void packet2memory(PACKET p,
-//                    hls::stream<PacketInMemory> &stream,
-//                    ap_uint<axiWord::WIDTH> *data) {
-//     static Allocator<256> allocator;
-//     int index = allocator.allocate();
-
-//     const int S = axiWord::WIDTH/8;
-//     const int PacketOffset = 2048/S;
-//     if(index != -1) {
-//         for(int i = 0; i < (p.data_length()+S-1)/S; i++) {
-//             ap_uint<axiWord::WIDTH> v;
-//             ap_uint<S> k;
-//             p.pop(v,k);
-//             data[PacketOffset*index+i] = v;
-//         }
-//         PacketInMemory pim;
-//         pim.index = index;
-//         pim.length = p.data_length();
-//         stream.write(pim);
-//     } else {
-//         // Drop
-//     }
-// }
-
-// template <typename PACKET>
-// void memory2packet(hls::stream<PacketInMemory> &stream,
-//                    ap_uint<axiWord::WIDTH> *data,
-//                    PACKET p) {
-//     const int S = axiWord::WIDTH/8;
-//     const int PacketOffset = 2048/S;
-//     PacketInMemory pim;
-//     pim = stream.read();
-//     ap_uint<S> alignflag = generatekeep<S>(pim.length%S);
-//     const int LBEATS = (pim.length + S - 1) / S;
-//     for(int i = 0; i < LBEATS; i++) {
-//         ap_uint<axiWord::WIDTH> v;
-//         ap_uint<S> k;
-//         v = data[PacketOffset*pim.index+i];
-//         k = (i == LBEATS-1) ? alignflag : ap_uint<S>(-1);
-//         p.push(v,k);
-//     }
-// }
+// An allocator for ids 0 to N-1 which keeps the free ids in a ring, so that
+// allocate() reads the ring once and deallocate() writes it once.  Unlike
+// Allocator, this can allocate and deallocate in every cycle using the two
+// ports of a single memory, but it does not check deallocations or track
+// which ids are allocated.  Ids which have never been allocated are handed
+// out in order once the ring is empty, so the ring does not need to be
+// initialized.  N must be a power of 2.
+template <int N>
+class FifoAllocator {
+public:
+    typedef ap_uint<BitWidth<N-1>::Value> indexT;
+    typedef ap_uint<BitWidth<N>::Value> countT;
+    // The last FORWARD writes to the ring, newest first, so that a read of
+    // an id which is still being written returns the new id.
+    const static int FORWARD = 2;
+
+    indexT ring[N];
+    indexT head, tail;
+    countT count; // Ids in the ring.
+    countT fresh; // Ids which have never been allocated.
+    indexT last_pos[FORWARD];
+    indexT last_id[FORWARD];
+    bool last_valid[FORWARD];
+
+    FifoAllocator() {
+#pragma HLS array_partition variable=last_pos complete
+#pragma HLS array_partition variable=last_id complete
+#pragma HLS array_partition variable=last_valid complete
+        clear();
+    }
+    void clear() {
+        head = 0;
+        tail = 0;
+        count = 0;
+        fresh = 0;
+        for(int d = 0; d < FORWARD; d++) {
+#pragma HLS unroll
+            last_valid[d] = false;
+        }
+    }
+    // Return true if allocate() will succeed.
+    bool canAllocate() {
+        return count != 0 || fresh != N;
+    }
+    int allocate() {
+#pragma HLS dependence variable=ring inter false
+        if(count != 0) {
+            indexT id = ring[head];
+            for(int d = FORWARD-1; d >= 0; d--) {
+#pragma HLS unroll
+                if(last_valid[d] && last_pos[d] == head) id = last_id[d];
+            }
+            head++;
+            count--;
+            return id;
+        } else if(fresh != N) {
+            return fresh++;
+        } else {
+            return -1;
+        }
+    }
+    void deallocate(int id) {
+#pragma HLS dependence variable=ring inter false
+        assert(id >= 0 && id < N);
+        assert(size() > 0);
+        ring[tail] = id;
+        for(int d = FORWARD-1; d > 0; d--) {
+#pragma HLS unroll
+            last_pos[d] = last_pos[d-1];
+            last_id[d] = last_id[d-1];
+            last_valid[d] = last_valid[d-1];
+        }
+        last_pos[0] = tail;
+        last_id[0] = id;
+        last_valid[0] = true;
+        tail++;
+        count++;
+    }
+    // Deallocate free_id (if it is not negative) and, if allocate_valid is set,
+    // allocate an id, as a single operation.  When both happen, free_id is
+    // reallocated directly, so the ring is not accessed.
+    // Return the allocated id, or -1 if no id was allocated.
+    int allocate_and_free(int free_id, bool allocate_valid = true) {
+        if(free_id >= 0 && allocate_valid) {
+            return free_id;
+        } else if(free_id >= 0) {
+            deallocate(free_id);
+            return -1;
+        } else if(allocate_valid) {
+            return allocate();
+        } else {
+            return -1;
+        }
+    }
+    // Return the number of allocated ids.
+    int size() {
+        return fresh - count;
+    }
+};
+
+// An allocator which can allocate and deallocate up to K ids per call.  The
+// ids are split into K banks of N/K ids, each managed by an independent
+// Allocator, so each bank can perform one allocate and one deallocate per
+// cycle.  Allocations are spread across the banks which have free ids,
+// starting from a different bank each call.  Bank b holds ids b*(N/K)+1 to
+// (b+1)*(N/K)-1, so N-K ids can be allocated.
+// N/K must be a power of 2.
+template <int N, int K>
+class MultiAllocator {
+public:
+    const static int BANKSIZE = N/K;
+    Allocator<BANKSIZE> banks[K];
+    int startbank;
+    int findbank;
+
+    MultiAllocator() {
+#pragma HLS array_partition variable=banks complete
+        startbank = 0;
+        findbank = 0;
+    }
+    void clear() {
+        for(int b = 0; b < K; b++) {
+#pragma HLS unroll
+            banks[b].clear();
+        }
+        startbank = 0;
+        findbank = 0;
+    }
+    static int bank_of(int id) {
+        return id / BANKSIZE;
+    }
+    bool is_allocated(int id) {
+        return banks[bank_of(id)].is_allocated(id % BANKSIZE);
+    }
+    // Allocate up to n ids, writing them to ids[0] to ids[count-1].
+    // Return count, which is less than n if there are fewer than n banks with free ids.
+    int allocate(int n, int ids[K]) {
+#pragma HLS inline
+        // Rank the banks with free ids, starting from startbank.
+        int count = 0;
+        for(int i = 0; i < K; i++) {
+#pragma HLS unroll
+            int b = (startbank + i) % K;
+            if(count < n && banks[b].canAllocate()) {
+                ids[count] = b*BANKSIZE + banks[b].allocate();
+                count++;
+            }
+        }
+        startbank = (startbank + 1) % K;
+        return count;
+    }
+    // Allocate a single id, or return -1 if there are no free ids.
+    int allocate() {
+        int ids[K];
+        return (allocate(1, ids) == 1) ? ids[0] : -1;
+    }
+    // Deallocate the ids[i] for which valid[i] is set.  Each bank can only
+    // deallocate one id per call, so if several ids are in the same bank, then
+    // only the first is deallocated.
+    // Return a mask of the ids which were deallocated.  The others should be retried.
+    ap_uint<K> deallocate(ap_uint<K> valid, const int ids[K]) {
+#pragma HLS inline
+        ap_uint<K> done = 0;
+        ap_uint<K> busy = 0;
+        for(int i = 0; i < K; i++) {
+#pragma HLS unroll
+            int b = bank_of(ids[i]);
+            if(valid[i] && !busy[b]) {
+                busy[b] = true;
+                done[i] = true;
+            }
+        }
+        for(int b = 0; b < K; b++) {
+#pragma HLS unroll
+            for(int i = 0; i < K; i++) {
+#pragma HLS unroll
+                if(done[i] && bank_of(ids[i]) == b) {
+                    banks[b].deallocate(ids[i] % BANKSIZE);
+                }
+            }
+        }
+        return done;
+    }
+    void deallocate(int id) {
+        banks[bank_of(id)].deallocate(id % BANKSIZE);
+    }
+    // Return an allocated id, visiting the allocated ids of each bank in turn,
+    // or -1 if no id is allocated.
+    int find_allocated() {
+        for(int i = 0; i < K; i++) {
+#pragma HLS unroll
+            int b = (findbank + i) % K;
+            if(banks[b].size() > 0) {
+                findbank = (b + 1) % K;
+                return b*BANKSIZE + banks[b].find_allocated();
+            }
+        }
+        return -1;
+    }
+    int size() {
+        int count = 0;
+        for(int b = 0; b < K; b++) {
+#pragma HLS unroll
+            count += banks[b].size();
+        }
+        return count;
+    }
+};
 
 template<typename T, int N>
 class MessageBuffer {
@@ -201,6 +383,13 @@ public:
         if(id >= 0) data[id] = t;
         return id;
     }
+    // Remove the value associated with clear_id and put a new value t into the buffer
+    // in the same cycle.  The id of the new value is returned, which may be clear_id.
+    int put_and_clear(T t, int clear_id) {
+        int id = allocator.allocate_and_free(clear_id);
+        if(id >= 0) data[id] = t;
+        return id;
+    }
     // Get a random value from the buffer along with it's id.  If no id is not currently allocated, then the return value is undefined and
     // id is set to -1.
     T get(int &id) {
@@ -221,3 +410,127 @@ public:
         return allocator.size();
     }
 };
+
+// An allocator for variable-length regions of an arena of WordT.  Size class c
+// holds SLOTS regions of MINWORDS<<c words, whose free slots are managed by an
+// Allocator.  Requests are served from the smallest class with a free region
+// which is large enough.  A region is identified by a handle, which encodes the
+// class and slot.
+template <typename WordT, int CLASSES, int SLOTS, int MINWORDS>
+class SlabAllocator {
+public:
+    const static int SLOTBITS = BitWidth<SLOTS>::Value;
+    const static int ARENAWORDS = SLOTS*MINWORDS*((1 << CLASSES) - 1);
+    Allocator<SLOTS+1> slabs[CLASSES];
+    WordT arena[ARENAWORDS];
+
+    SlabAllocator() {
+#pragma HLS array_partition variable=slabs complete
+    }
+    void clear() {
+        for(int c = 0; c < CLASSES; c++) {
+#pragma HLS unroll
+            slabs[c].clear();
+        }
+    }
+    static int size_class(int handle) {
+        return handle >> SLOTBITS;
+    }
+    static int slot(int handle) {
+        return handle & ((1 << SLOTBITS) - 1);
+    }
+    // Return the number of words in the region identified by handle.
+    static int capacity(int handle) {
+        return MINWORDS << size_class(handle);
+    }
+    // Return the offset in the arena of the region identified by handle.
+    static int base(int handle) {
+        int c = size_class(handle);
+        return SLOTS*MINWORDS*((1 << c) - 1) + (slot(handle)-1)*(MINWORDS << c);
+    }
+    bool is_allocated(int handle) {
+        return slabs[size_class(handle)].is_allocated(slot(handle));
+    }
+    // Allocate a region of at least words words.
+    // Return a handle for the region, or -1 if there is no free region large enough.
+    int allocate(int words) {
+        int handle = -1;
+        for(int c = CLASSES-1; c >= 0; c--) {
+#pragma HLS unroll
+            if((MINWORDS << c) >= words && slabs[c].canAllocate()) {
+                handle = c;
+            }
+        }
+        if(handle >= 0) {
+            handle = (handle << SLOTBITS) | slabs[handle].allocate();
+        }
+        return handle;
+    }
+    void deallocate(int handle) {
+        slabs[size_class(handle)].deallocate(slot(handle));
+    }
+    WordT read(int handle, int i) {
+        assert(i < capacity(handle));
+        return arena[base(handle) + i];
+    }
+    void write(int handle, int i, const WordT &w) {
+        assert(i < capacity(handle));
+        arena[base(handle) + i] = w;
+    }
+};
+
+// A MessageBuffer which stores messages of up to MAXWORDS words of WordT,
+// each in a region of a SlabAllocator sized for the message.
+template<typename WordT, int N, int MAXWORDS, typename SlabT>
+class VariableMessageBuffer {
+public:
+    Allocator<N> allocator;
+    SlabT slab;
+    int handles[N];
+    ap_uint<BitWidth<MAXWORDS>::Value> lengths[N];
+
+    VariableMessageBuffer() { }
+    bool is_allocated(int id) {
+        return allocator.is_allocated(id);
+    }
+    // Put a new message of length words into the buffer.  If this succeeds, then return an id associated with the
+    // message in the buffer.  Otherwise return -1.
+    int put(const WordT msg[MAXWORDS], int length) {
+        assert(length <= MAXWORDS);
+        if(!allocator.canAllocate()) return -1;
+        int handle = slab.allocate(length);
+        if(handle < 0) return -1;
+        int id = allocator.allocate();
+        handles[id] = handle;
+        lengths[id] = length;
+        for(int i = 0; i < length; i++) {
+#pragma HLS pipeline II=1
+            slab.write(handle, i, msg[i]);
+        }
+        return id;
+    }
+    // Get a random message from the buffer along with it's id, and return its length.
+    // If no id is currently allocated, then return 0 and set id to -1.
+    int get(int &id, WordT msg[MAXWORDS]) {
+        id = allocator.find_allocated();
+        if(id < 0) return 0;
+        int handle = handles[id];
+        int length = lengths[id];
+        for(int i = 0; i < length; i++) {
+#pragma HLS pipeline II=1
+            msg[i] = slab.read(handle, i);
+        }
+        return length;
+    }
+    void clear() {
+        allocator.clear();
+        slab.clear();
+    }
+    void clear(int id) {
+        slab.deallocate(handles[id]);
+        allocator.deallocate(id);
+    }
+    int size() {
+        return allocator.size();
+    }
+};
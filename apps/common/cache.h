@@ -0,0 +1,238 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "cam.h"
+
+namespace hls {
+
+    // An N-way set-associative cache.  Each key is hashed to one of Sets
+    // sets, and can be stored in any of the Ways ways of that set.  Policy
+    // (no_replacement, lru_replacement, plru_replacement or random_replacement)
+    // determines which way is evicted when inserting into a full set.  Each
+    // operation reads and writes a single set, so lookups and inserts run with
+    // II=1.  The last FORWARD sets written are forwarded, so that operations
+    // on the same set a few cycles apart do not stall.
+    // Sets is power of 2.
+    template <int Sets, int Ways, typename KeyT, typename ValueT, typename Policy = lru_replacement>
+    class set_assoc_cache {
+    public:
+        const static int HASHBITS = BitWidth<Sets-1>::Value;
+        const static int WAYBITS = BitWidth<Ways-1>::Value;
+        static const bool LRU = same_policy<Policy, lru_replacement>::value;
+        static const bool PLRU = same_policy<Policy, plru_replacement>::value;
+        static const bool RANDOM = same_policy<Policy, random_replacement>::value;
+        typedef ap_uint<HASHBITS> HashT;
+        typedef ap_uint<WAYBITS> WayT;
+
+        struct set_t {
+            KeyT keys[Ways];
+            ValueT values[Ways];
+            ap_uint<Ways> valid;
+            // Ways used since the last time that every way was used (PLRU only).
+            ap_uint<Ways> used;
+            // The number of other ways used more recently than each way (LRU only).
+            WayT rank[Ways];
+        };
+
+        set_t sets[Sets];
+        h3_hash<KeyT, HASHBITS, 1> hasher;
+        // The last FORWARD sets written, newest first, so that operations on
+        // a set can be pipelined while the previous write is still in flight.
+        const static int FORWARD = 2;
+        HashT last_hash[FORWARD];
+        set_t last_set[FORWARD];
+        bool last_valid[FORWARD];
+        ap_uint<16> lfsr;
+
+        set_assoc_cache() {
+#pragma HLS data_pack variable=sets
+#pragma HLS array_partition variable=last_hash complete
+#pragma HLS array_partition variable=last_set complete
+#pragma HLS array_partition variable=last_valid complete
+            lfsr = 0xACE1;
+            clear();
+        }
+        void clear() {
+            for(int i = 0; i < Sets; i++) {
+#pragma HLS pipeline II=1
+                set_t s;
+                s.valid = 0;
+                s.used = 0;
+                for(int j = 0; j < Ways; j++) {
+                    s.rank[j] = j;
+                }
+                sets[i] = s;
+            }
+            for(int d = 0; d < FORWARD; d++) {
+                last_valid[d] = false;
+            }
+        }
+        set_t read_set(const HashT &hash) {
+            set_t s = sets[hash];
+            for(int d = FORWARD-1; d >= 0; d--) {
+#pragma HLS unroll
+                if(last_valid[d] && last_hash[d] == hash) s = last_set[d];
+            }
+            return s;
+        }
+        void write_set(const HashT &hash, const set_t &s) {
+            sets[hash] = s;
+            for(int d = FORWARD-1; d > 0; d--) {
+#pragma HLS unroll
+                last_hash[d] = last_hash[d-1];
+                last_set[d] = last_set[d-1];
+                last_valid[d] = last_valid[d-1];
+            }
+            last_hash[0] = hash;
+            last_set[0] = s;
+            last_valid[0] = true;
+        }
+        // Return a mask of the valid ways of s which hold key.
+        ap_uint<Ways> match(const set_t &s, const KeyT &key) {
+            ap_uint<Ways> matches;
+            for(int j = 0; j < Ways; j++) {
+#pragma HLS unroll
+                matches[j] = s.valid[j] && s.keys[j] == key;
+            }
+            return matches;
+        }
+        // Record a use of way w for the replacement policy.
+        void touch(set_t &s, const WayT &w) {
+            if(LRU) {
+                WayT r = s.rank[w];
+                for(int j = 0; j < Ways; j++) {
+#pragma HLS unroll
+                    if(s.rank[j] < r) s.rank[j]++;
+                }
+                s.rank[w] = 0;
+            } else if(PLRU) {
+                s.used[w] = true;
+                if((s.used & s.valid) == s.valid) {
+                    s.used = 0;
+                    s.used[w] = true;
+                }
+            }
+        }
+        // Select a way of a full set to evict according to the replacement policy.
+        WayT victim(const set_t &s) {
+            WayT w = Ways-1;
+            if(LRU) {
+                for(int j = 0; j < Ways; j++) {
+#pragma HLS unroll
+                    if(s.rank[j] == Ways-1) w = j;
+                }
+            } else if(PLRU) {
+                for(int j = Ways-1; j >= 0; j--) {
+#pragma HLS unroll
+                    if(!s.used[j]) w = j;
+                }
+            } else if(RANDOM) {
+                bool lsb = lfsr[0];
+                lfsr >>= 1;
+                if(lsb) lfsr ^= 0xB400;
+                w = lfsr % Ways;
+            }
+            return w;
+        }
+
+        // Retrieve the value associated with the given key in the cache.
+        // If promote is true, then a hit also counts as a use of the entry
+        // for the replacement policy.
+        // Return true if there is such a value, or false if there is no such value.
+        bool get(const KeyT &key, ValueT &value, bool promote = true) {
+#pragma HLS pipeline II=1
+#pragma HLS dependence variable=sets inter false
+            HashT hash = hasher.hash(key, 0);
+            set_t s = read_set(hash);
+            ap_uint<Ways> matches = match(s, key);
+            if(matches == 0) return false;
+            WayT w = matches.reverse().countLeadingZeros();
+            value = s.values[w];
+            if(promote && (LRU || PLRU)) {
+                touch(s, w);
+                write_set(hash, s);
+            }
+            return true;
+        }
+        bool canInsert(const KeyT &key) {
+            if(LRU || PLRU || RANDOM) return true;
+            set_t s = read_set(hasher.hash(key, 0));
+            return match(s, key) != 0 || s.valid != ap_uint<Ways>(-1);
+        }
+        // Add a new entry in the cache with the given key and value.  If an
+        // entry already exists with the given key, then it is replaced.  If
+        // the set is full, then an entry is evicted according to the
+        // replacement policy and returned in evicted_key and evicted_value,
+        // and evicted is set.
+        // Return true if the operation succeeds or false if it fails.
+        bool insert(const KeyT &key, const ValueT &value,
+                    KeyT &evicted_key, ValueT &evicted_value, bool &evicted) {
+#pragma HLS pipeline II=1
+#pragma HLS dependence variable=sets inter false
+            HashT hash = hasher.hash(key, 0);
+            set_t s = read_set(hash);
+            ap_uint<Ways> matches = match(s, key);
+            ap_uint<Ways> empty = ~s.valid;
+            WayT w;
+            evicted = false;
+            if(matches != 0) {
+                w = matches.reverse().countLeadingZeros();
+            } else if(empty != 0) {
+                w = empty.reverse().countLeadingZeros();
+            } else if(LRU || PLRU || RANDOM) {
+                w = victim(s);
+                evicted_key = s.keys[w];
+                evicted_value = s.values[w];
+                evicted = true;
+            } else {
+                return false;
+            }
+            s.keys[w] = key;
+            s.values[w] = value;
+            s.valid[w] = true;
+            touch(s, w);
+            write_set(hash, s);
+#ifdef DEBUG
+            std::cout << "Insert " << key << "->" << value << " in [" << hash << "][" << w << "]";
+            if(evicted) std::cout << " evicted " << evicted_key << "->" << evicted_value;
+            std::cout << "\n";
+#endif
+            return true;
+        }
+        bool insert(const KeyT &key, const ValueT &value) {
+            KeyT evicted_key;
+            ValueT evicted_value;
+            bool evicted;
+            return insert(key, value, evicted_key, evicted_value, evicted);
+        }
+        // Remove the value associated with the given key in the cache.
+        // Return true if there is such a value, or false if there is no such value.
+        bool remove(const KeyT &key) {
+#pragma HLS pipeline II=1
+#pragma HLS dependence variable=sets inter false
+            HashT hash = hasher.hash(key, 0);
+            set_t s = read_set(hash);
+            ap_uint<Ways> matches = match(s, key);
+            s.valid &= ~matches;
+            s.used &= ~matches;
+            write_set(hash, s);
+            return matches != 0;
+        }
+    };
+}
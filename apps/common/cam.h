@@ -44,6 +44,65 @@ namespace hls {
         return match_table[x];
     }
 
+    // A family of HASHES independent hash functions from KeyT to HASHBITS bits.
+    // Each bit of the hash is created by selecting bits of the key, and then
+    // XORing them together (i.e. H3 hashing).  The selection masks are
+    // generated randomly.
+    template <typename KeyT, int HASHBITS, int HASHES>
+    class h3_hash {
+    public:
+        const static int KEYBITS = Type_BitWidth<KeyT>::Value;
+        typedef ap_uint<HASHBITS> HashT;
+
+        KeyT hashes[HASHBITS][HASHES];
+
+        h3_hash() {
+            init_hashes();
+            #pragma HLS array_partition variable=hashes complete dim=0
+        }
+        HashT hash(const KeyT &key, int n) const {
+            HashT t;
+            for(int i = 0; i < HASHBITS; i++) {
+#pragma HLS unroll
+                KeyT select = key & hashes[i][n];
+                t[i] = select.xor_reduce();
+            }
+            return t;
+        }
+
+        template <int N>
+        ap_uint<N> random_permute(ap_uint<N> x) {
+            for (int i = N - 1; i >= 1; i--) {
+                /* 0 <= r <= i */
+                int r = JKISS() % (i+1);
+                bool temp = x[i];
+                x[i] = x[r];
+                x[r] = temp;
+            }
+            return x;
+        }
+        void init_hashes() {
+            // Each bit of the key is selected by 50% of the hash bits.
+            // Each hash is randomly generated independently.
+            ap_uint<KEYBITS> x=0;
+            // Set half the bits of x.
+            for(int i = 0; i < KEYBITS/2; i++) {
+#pragma HLS unroll
+                x[i] = true;
+            }
+            for(int i = 0; i < HASHBITS; i++) {
+
+            	for(int j = 0; j < HASHES; j++) {
+                    // randomly shuffle x.
+                    x = random_permute(x);
+                    hashes[i][j] = x;
+                    // std::cout << "hashes[" << i << "][" << j << "]:"
+                    //           << hashes[i][j].toString(2, false) << "\n";
+                }
+            }
+        }
+    };
+
     // Populate matches based on the current keys.
     template <int SIZE, typename KeyT>
     void parallel_match(const KeyT &key, KeyT keys[SIZE], ap_uint<SIZE> &matches) {
@@ -122,60 +181,166 @@ namespace hls {
         }
     };
 
-    template <int SIZE, typename KeyT, typename ValueT>
+    // Replacement policies for cam, which determine what happens when
+    // an entry is inserted into a full cam.
+    // Insertion fails.
+    struct no_replacement {};
+    // The least recently used entry is evicted.  This is the last entry
+    // in the shift-register ordering.
+    struct lru_replacement {};
+    // An entry which has not been used since the last time that every
+    // entry was used is evicted (i.e. bit-PLRU).
+    struct plru_replacement {};
+    // A pseudo-random entry is evicted.
+    struct random_replacement {};
+
+    template <typename A, typename B>
+    struct same_policy {
+        static const bool value = false;
+    };
+    template <typename A>
+    struct same_policy<A, A> {
+        static const bool value = true;
+    };
+
+    template <int SIZE, typename KeyT, typename ValueT, typename Policy = no_replacement>
     class cam;
 
-    template <int SIZE, typename KeyT, typename ValueT>
-    std::ostream& operator<<(std::ostream& os, const cam<SIZE, KeyT, ValueT>& cam);
+    template <int SIZE, typename KeyT, typename ValueT, typename Policy>
+    std::ostream& operator<<(std::ostream& os, const cam<SIZE, KeyT, ValueT, Policy>& cam);
 
-    template <int SIZE, typename KeyT, typename ValueT>
+    template <int SIZE, typename KeyT, typename ValueT, typename Policy>
     class cam {
+    public:
+        // The number of passes of an aging hand since an entry was inserted.
+        typedef ap_uint<4> AgeT;
+    private:
         typedef int HashT;
+        static const bool LRU = same_policy<Policy, lru_replacement>::value;
+        static const bool PLRU = same_policy<Policy, plru_replacement>::value;
+        static const bool RANDOM = same_policy<Policy, random_replacement>::value;
+        static const bool REPLACE = LRU || PLRU || RANDOM;
         KeyT keys[SIZE];
         ValueT values[SIZE];
         ap_uint<SIZE> valid;
+        // Entries used since the last time that every entry was used (PLRU only).
+        ap_uint<SIZE> used;
+        AgeT ages[SIZE];
+        ap_uint<16> lfsr;
+
+        // Record a use of the matching entry.
+        void touch(ap_uint<SIZE> matches) {
+            if(matches == 0) return;
+            if(LRU) {
+                // Move the matching entry to the front.
+                KeyT oldkeys[SIZE];
+                ValueT oldvalues[SIZE];
+                AgeT oldages[SIZE];
+                for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                    oldkeys[i] = keys[i];
+                    oldvalues[i] = values[i];
+                    oldages[i] = ages[i];
+                }
+                ap_uint<SIZE> oldvalid = valid;
+                ap_uint<SIZE> oldused = used;
+                ap_uint<SIZE> below = 0;
+                for(int i = 1; i < SIZE; i++) {
+#pragma HLS unroll
+                    below[i] = below[i-1] | matches[i-1];
+                    if(!below[i]) {
+                        keys[i] = oldkeys[i-1];
+                        values[i] = oldvalues[i-1];
+                        ages[i] = oldages[i-1];
+                        valid[i] = oldvalid[i-1];
+                        used[i] = oldused[i-1];
+                    }
+                }
+                ap_uint<SIZE> m = matches;
+                selector<SIZE, KeyT>::parallel_select(keys[0], m, oldkeys);
+                selector<SIZE, ValueT>::parallel_select(values[0], m, oldvalues);
+                selector<SIZE, AgeT>::parallel_select(ages[0], m, oldages);
+                valid[0] = true;
+                used[0] = false;
+            } else if(PLRU) {
+                used |= matches;
+                if((used & valid) == valid) used = matches;
+            }
+        }
+        // If the cam is full, then select an entry to evict according to the
+        // replacement policy and mark it as not valid.
+        void evict() {
+            if(valid != ap_uint<SIZE>(-1)) return;
+            ap_uint<BitWidth<SIZE>::Value> victim = SIZE-1;
+            if(PLRU) {
+                for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                    if(!used[i]) victim = i;
+                }
+            } else if(RANDOM) {
+                bool lsb = lfsr[0];
+                lfsr >>= 1;
+                if(lsb) lfsr ^= 0xB400;
+                victim = lfsr % SIZE;
+            }
+            valid[victim] = false;
+            used[victim] = false;
+        }
 
     public:
         cam() {
             valid = 0;
+            used = 0;
+            lfsr = 0xACE1;
             for(int i = 0; i < SIZE; i++) {
 #pragma HLS unroll
                 keys[i] = 0;
+                ages[i] = 0;
                 // values[i] = 0;
             }
             #pragma HLS array_partition variable=keys complete
             #pragma HLS array_partition variable=values complete
+            #pragma HLS array_partition variable=ages complete
             #pragma HLS reset variable=valid
         }
         void clear() {
             valid = 0;
+            used = 0;
         }
         // Retrieve the value associated with the given key in the cam.
+        // If promote is true, then a hit also counts as a use of the entry
+        // for the replacement policy.
         // Return true if there is such a value, or false if there is no such value.
-        bool get(const KeyT &key, ValueT &value) {
+        bool get(const KeyT &key, ValueT &value, bool promote = false) {
             ap_uint<SIZE> matches;
             parallel_match(key, keys, matches);
             matches &= valid;
-            return selector<SIZE, ValueT>::parallel_select(value, matches, values);
+            bool hit = selector<SIZE, ValueT>::parallel_select(value, matches, values);
+            if(REPLACE && promote) touch(matches);
+            return hit;
         }
         bool canInsert() {
-            if(valid == ap_uint<SIZE>(-1)) {
+            if(!REPLACE && valid == ap_uint<SIZE>(-1)) {
                 return false;
             } else {
                 return true;
             }
         }
-        // If there is space in the cam, add a new entry in the cam
-        // with the given key and value.  If an entry
-        // already exists with the given rkey, then it is replaced.
+        // Add a new entry in the cam with the given key, value and age.  If an entry
+        // already exists with the given rkey, then it is replaced.  If the cam is
+        // full, then an entry is evicted according to the replacement policy.
         // Return true if the operation succeeds or false if it fails.
-        bool swap(const KeyT &rkey, const KeyT &key, const ValueT &value, bool add = true) {
+        bool swap(const KeyT &rkey, const KeyT &key, const ValueT &value, bool add = true,
+                  const AgeT &age = 0) {
             ap_uint<SIZE> matches;
             // Find the element, if any that matches.
             parallel_match(rkey, keys, matches);
             valid &= ~matches; // Mark matches as not valid
             //            matches &= valid;
 
+            if(REPLACE && add) {
+                evict();
+            }
             if(valid == ap_uint<SIZE>(-1)) {
                 // Is the cam is full and we can't overwrite an existing element,
                 // then we have to fail.
@@ -185,13 +350,17 @@ namespace hls {
             // Capture the old values.
             KeyT oldkeys[SIZE];
             ValueT oldvalues[SIZE];
+            AgeT oldages[SIZE];
             ap_uint<SIZE> oldvalid;
+            ap_uint<SIZE> oldused;
             for(int i = 0; i < SIZE; i++) {
 #pragma HLS unroll
                 oldkeys[i] = keys[i];
                 oldvalues[i] = values[i];
+                oldages[i] = ages[i];
             }
             oldvalid = valid;
+            oldused = used;
 
             // no match.  Insertion point is initial element.
             // Push other elements down by one.
@@ -202,12 +371,17 @@ namespace hls {
                 if(oldvalid[i-1]) {
                     keys[i] = oldkeys[i-1];
                     values[i] = oldvalues[i-1];
+                    ages[i] = oldages[i-1];
                     valid[i] = oldvalid[i-1];
+                    used[i] = oldused[i-1];
                 } else break;
             }
             keys[0] = key;
             values[0] = value;
+            ages[0] = age;
             valid[0] = add;
+            used[0] = false;
+            if(PLRU && add) touch(1);
             return true;
         }
         // If there is space in the cam, add a new entry in the cam
@@ -238,15 +412,33 @@ namespace hls {
                 return true;
             }
         }
+        // Return the key, value and age of the oldest entry, if one exists.
+        // If this is possible, return true, else return false.
+        bool oldest(KeyT &key, ValueT &value, AgeT &age) {
+            bool found = false;
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                if(valid[i]) {
+                    key = keys[i];
+                    value = values[i];
+                    age = ages[i];
+                    found = true;
+                }
+            }
+            return found;
+        }
         void shift() {
             if(!valid[SIZE-1]) {
                 for(int i = SIZE-1; i > 0; i--) {
 #pragma HLS unroll
                     keys[i] = keys[i-1];
                     values[i] = values[i-1];
+                    ages[i] = ages[i-1];
                     valid[i] = valid[i-1];
+                    used[i] = used[i-1];
                 }
                 valid[0] = false;
+                used[0] = false;
             }
         }
 
@@ -260,13 +452,61 @@ namespace hls {
             valid &= ~matches;
             return (matches != 0);
         }
+        // Return the key and value stored in entry i.
+        // Return true if the entry is valid, or false if it is not valid.
+        bool get_entry(int i, KeyT &key, ValueT &value) {
+            key = keys[i];
+            value = values[i];
+            return valid[i];
+        }
+        // Replace the value stored in entry i.
+        void set_value(int i, const ValueT &value) {
+            values[i] = value;
+        }
+        // Increment the age of entry i, and remove it if its age reaches timeout.
+        // Return true if the entry is removed, along with its key and value.
+        bool age_entry(int i, const AgeT &timeout, KeyT &key, ValueT &value) {
+            if(!valid[i]) return false;
+            AgeT a = ages[i] + 1;
+            key = keys[i];
+            value = values[i];
+            if(a >= timeout) {
+                valid[i] = false;
+                return true;
+            }
+            ages[i] = a;
+            return false;
+        }
+        // Reset the age of the entry with the given key.
+        void reset_age(const KeyT &key) {
+            ap_uint<SIZE> matches;
+            parallel_match(key, keys, matches);
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                if(matches[i]) ages[i] = 0;
+            }
+        }
+        // Remove every entry for which pred(key, value) returns true.
+        // Return the number of entries removed.
+        template <typename Pred>
+        int clear_if(Pred &pred) {
+            int count = 0;
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                if(valid[i] && pred(keys[i], values[i])) {
+                    valid[i] = false;
+                    count++;
+                }
+            }
+            return count;
+        }
 
-        friend std::ostream& operator<< <SIZE, KeyT, ValueT>(std::ostream& os, const cam<SIZE, KeyT, ValueT>& cam);
+        friend std::ostream& operator<< <SIZE, KeyT, ValueT, Policy>(std::ostream& os, const cam<SIZE, KeyT, ValueT, Policy>& cam);
 
     };
 
-    template <int SIZE, typename KeyT, typename ValueT>
-    std::ostream& operator<<(std::ostream& os, const cam<SIZE, KeyT, ValueT>& cam) {
+    template <int SIZE, typename KeyT, typename ValueT, typename Policy>
+    std::ostream& operator<<(std::ostream& os, const cam<SIZE, KeyT, ValueT, Policy>& cam) {
          for(int i = 0; i < SIZE; i++) {
              os << i << ":";
              if(cam.valid[i]) {
@@ -276,6 +516,471 @@ namespace hls {
          return os;
     }
 
+    // A ternary cam, where each entry matches the bits of the key selected
+    // by a mask.  When several entries match, then the value of the entry
+    // with the highest priority is returned.  Entries with equal priority
+    // are resolved in favor of the lowest numbered entry.  Lookups are
+    // compared against every entry in parallel with II=1.
+    template <int SIZE, typename KeyT, typename ValueT, typename PriorityT = ap_uint<8> >
+    class tcam {
+        KeyT keys[SIZE];
+        KeyT masks[SIZE];
+        ValueT values[SIZE];
+        PriorityT priorities[SIZE];
+        ap_uint<SIZE> valid;
+
+        // Return the entries which match key under their own masks.
+        ap_uint<SIZE> match(const KeyT &key) {
+            ap_uint<SIZE> matches;
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                matches[i] = valid[i] && ((key & masks[i]) == keys[i]);
+            }
+            return matches;
+        }
+        // Return the entries which were inserted with the same key and mask.
+        ap_uint<SIZE> find(const KeyT &key, const KeyT &mask) {
+            ap_uint<SIZE> matches;
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                matches[i] = valid[i] && masks[i] == mask && keys[i] == (key & mask);
+            }
+            return matches;
+        }
+
+    public:
+        tcam() {
+            valid = 0;
+            #pragma HLS array_partition variable=keys complete
+            #pragma HLS array_partition variable=masks complete
+            #pragma HLS array_partition variable=values complete
+            #pragma HLS array_partition variable=priorities complete
+            #pragma HLS reset variable=valid
+        }
+        void clear() {
+            valid = 0;
+        }
+        // Retrieve the value of the highest priority entry matching key.
+        // Return true if there is such an entry, or false if there is no such entry.
+        bool get(const KeyT &key, ValueT &value) {
+#pragma HLS pipeline II=1
+            ap_uint<SIZE> matches = match(key);
+            bool hit = false;
+            PriorityT best = 0;
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                if(matches[i] && (!hit || priorities[i] > best)) {
+                    value = values[i];
+                    best = priorities[i];
+                    hit = true;
+                }
+            }
+            return hit;
+        }
+        bool canInsert() {
+            return valid != ap_uint<SIZE>(-1);
+        }
+        // Add a new entry matching the bits of key selected by mask.  If an
+        // entry already exists with the same key and mask, then it is replaced.
+        // Return true if the operation succeeds or false if the tcam is full.
+        bool insert(const KeyT &key, const KeyT &mask, const ValueT &value,
+                    const PriorityT &priority = 0) {
+            ap_uint<SIZE> matches = find(key, mask);
+            // Reuse the matching entry, or else the lowest free entry.
+            ap_uint<SIZE> slots = (matches != 0) ? matches : ap_uint<SIZE>(~valid);
+            if(slots == 0) return false;
+            int i = slots.reverse().countLeadingZeros();
+            keys[i] = key & mask;
+            masks[i] = mask;
+            values[i] = value;
+            priorities[i] = priority;
+            valid[i] = true;
+            return true;
+        }
+        // Remove the entry with the given key and mask.
+        // Return true if there is such an entry, or false if there is no such entry.
+        bool remove(const KeyT &key, const KeyT &mask) {
+            ap_uint<SIZE> matches = find(key, mask);
+            valid &= ~matches;
+            return matches != 0;
+        }
+        // Return the key, mask and value stored in entry i.
+        // Return true if the entry is valid, or false if it is not valid.
+        bool get_entry(int i, KeyT &key, KeyT &mask, ValueT &value) {
+            key = keys[i];
+            mask = masks[i];
+            value = values[i];
+            return valid[i];
+        }
+    };
+
+    // A longest prefix match table, where each entry matches the most
+    // significant prefixlen bits of the key.  This is a tcam where the
+    // priority of each entry is its prefix length.
+    template <int SIZE, typename KeyT, typename ValueT>
+    class lpm_cam {
+    public:
+        const static int KEYBITS = Type_BitWidth<KeyT>::Value;
+        typedef ap_uint<BitWidth<KEYBITS>::Value> PrefixT;
+
+        tcam<SIZE, KeyT, ValueT, PrefixT> entries;
+
+        // Return the mask selecting the most significant prefixlen bits of a key.
+        static KeyT prefix_mask(const PrefixT &prefixlen) {
+            ap_uint<KEYBITS> mask = 0;
+            for(int i = 0; i < KEYBITS; i++) {
+#pragma HLS unroll
+                mask[i] = (KEYBITS - i) <= prefixlen;
+            }
+            return mask;
+        }
+        void clear() {
+            entries.clear();
+        }
+        // Retrieve the value of the longest prefix matching key.
+        // Return true if there is such a prefix, or false if there is no such prefix.
+        bool get(const KeyT &key, ValueT &value) {
+#pragma HLS pipeline II=1
+            return entries.get(key, value);
+        }
+        bool canInsert() {
+            return entries.canInsert();
+        }
+        // Add a new prefix.  If the prefix already exists, then its value is replaced.
+        // Return true if the operation succeeds or false if the table is full.
+        bool insert(const KeyT &key, const PrefixT &prefixlen, const ValueT &value) {
+            return entries.insert(key, prefix_mask(prefixlen), value, prefixlen);
+        }
+        // Remove the given prefix.
+        // Return true if there is such a prefix, or false if there is no such prefix.
+        bool remove(const KeyT &key, const PrefixT &prefixlen) {
+            return entries.remove(key, prefix_mask(prefixlen));
+        }
+    };
+
+    // A range match table, where each entry matches keys in the interval
+    // [lo, hi].  When several entries match, then the value of the entry with
+    // the highest priority is returned.  Entries with equal priority are
+    // resolved in favor of the lowest numbered entry.  Lookups are compared
+    // against every entry in parallel with II=1.
+    template <int SIZE, typename KeyT, typename ValueT, typename PriorityT = ap_uint<8> >
+    class range_cam {
+        KeyT los[SIZE];
+        KeyT his[SIZE];
+        ValueT values[SIZE];
+        PriorityT priorities[SIZE];
+        ap_uint<SIZE> valid;
+
+        // Return the entries which were inserted with the same interval.
+        ap_uint<SIZE> find(const KeyT &lo, const KeyT &hi) {
+            ap_uint<SIZE> matches;
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                matches[i] = valid[i] && los[i] == lo && his[i] == hi;
+            }
+            return matches;
+        }
+
+    public:
+        range_cam() {
+            valid = 0;
+            #pragma HLS array_partition variable=los complete
+            #pragma HLS array_partition variable=his complete
+            #pragma HLS array_partition variable=values complete
+            #pragma HLS array_partition variable=priorities complete
+            #pragma HLS reset variable=valid
+        }
+        void clear() {
+            valid = 0;
+        }
+        // Retrieve the value of the highest priority entry whose interval contains key.
+        // Return true if there is such an entry, or false if there is no such entry.
+        bool get(const KeyT &key, ValueT &value) {
+#pragma HLS pipeline II=1
+            ap_uint<SIZE> matches;
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                matches[i] = valid[i] && los[i] <= key && key <= his[i];
+            }
+            bool hit = false;
+            PriorityT best = 0;
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                if(matches[i] && (!hit || priorities[i] > best)) {
+                    value = values[i];
+                    best = priorities[i];
+                    hit = true;
+                }
+            }
+            return hit;
+        }
+        bool canInsert() {
+            return valid != ap_uint<SIZE>(-1);
+        }
+        // Add a new entry matching keys in [lo, hi].  If an entry already
+        // exists with the same interval, then it is replaced.
+        // Return true if the operation succeeds or false if the table is full.
+        bool insert(const KeyT &lo, const KeyT &hi, const ValueT &value,
+                    const PriorityT &priority = 0) {
+            ap_uint<SIZE> matches = find(lo, hi);
+            // Reuse the matching entry, or else the lowest free entry.
+            ap_uint<SIZE> slots = (matches != 0) ? matches : ap_uint<SIZE>(~valid);
+            if(slots == 0) return false;
+            int i = slots.reverse().countLeadingZeros();
+            los[i] = lo;
+            his[i] = hi;
+            values[i] = value;
+            priorities[i] = priority;
+            valid[i] = true;
+            return true;
+        }
+        // Remove the entry with the given interval.
+        // Return true if there is such an entry, or false if there is no such entry.
+        bool remove(const KeyT &lo, const KeyT &hi) {
+            ap_uint<SIZE> matches = find(lo, hi);
+            valid &= ~matches;
+            return matches != 0;
+        }
+        // Return the interval and value stored in entry i.
+        // Return true if the entry is valid, or false if it is not valid.
+        bool get_entry(int i, KeyT &lo, KeyT &hi, ValueT &value) {
+            lo = los[i];
+            hi = his[i];
+            value = values[i];
+            return valid[i];
+        }
+    };
+
+    // A fully associative cam for large SIZE, where matching and selection are
+    // split across STAGES register stages so that the wide comparison and
+    // priority encoding does not limit the clock.  Lookups, inserts and removes
+    // all travel through the same pipeline and are accepted with II=1.  The
+    // result of a request is returned STAGES calls to process() later, in order.
+    // The stages are:
+    // 1: Compare the key against every entry.
+    // 2: Priority encode and select a value within each group of GROUP entries.
+    // 3..STAGES-1: Retiming registers.
+    // STAGES: Select between groups and apply any update.
+    // Requests which are in flight when an update to the same key is applied
+    // have the update forwarded to them, so back-to-back requests see the
+    // same results as if they were processed one at a time.
+    template <int SIZE, typename KeyT, typename ValueT, int STAGES = 3, int GROUP = 16>
+    class pipelined_cam {
+    public:
+        const static int GROUPS = SIZE/GROUP;
+        const static int GROUPBITS = BitWidth<GROUP-1>::Value;
+        const static int SLOTBITS = BitWidth<SIZE-1>::Value;
+        typedef ap_uint<SLOTBITS> SlotT;
+        typedef ap_uint<GROUPBITS> GroupSlotT;
+
+        const static int LOOKUP = 0;
+        const static int INSERT = 1;
+        const static int REMOVE = 2;
+
+        struct Request {
+            KeyT key;
+            ValueT value;
+            ap_uint<2> op;
+            Request(): key(0), value(0), op(LOOKUP) {}
+            Request(KeyT key, ValueT value, ap_uint<2> op): key(key), value(value), op(op) {}
+        };
+        // For a lookup, hit is true if the key was found.  For an insert, hit is
+        // true if the insert succeeded.  For a remove, hit is true if the key
+        // was removed.
+        struct Reply {
+            KeyT key;
+            ValueT value;
+            ap_uint<2> op;
+            bool hit;
+            Reply(): key(0), value(0), op(LOOKUP), hit(false) {}
+        };
+
+    private:
+        struct record {
+            bool valid;
+            Request req;
+            ap_uint<SIZE> matches;
+            ap_uint<GROUPS> group_hit;
+            GroupSlotT group_slot[GROUPS];
+            ValueT group_value[GROUPS];
+            // Set if an update to the same key was applied after this record
+            // was matched.
+            bool fwd;
+            bool fwd_hit;
+            SlotT fwd_slot;
+            ValueT fwd_value;
+        };
+
+        KeyT keys[SIZE];
+        ValueT values[SIZE];
+        ap_uint<SIZE> valid;
+        record pipe[STAGES];
+        // The lowest free entry in each group, computed after the previous update.
+        ap_uint<GROUPS> free_any;
+        GroupSlotT free_slot[GROUPS];
+
+        // Return the index of the lowest set bit in x.
+        template <int N>
+        static int priority_encode(ap_uint<N> x) {
+            int index = 0;
+            for(int i = N-1; i >= 0; i--) {
+#pragma HLS unroll
+                if(x[i]) index = i;
+            }
+            return index;
+        }
+
+    public:
+        pipelined_cam() {
+#pragma HLS array_partition variable=keys complete
+#pragma HLS array_partition variable=values complete
+#pragma HLS array_partition variable=pipe complete
+#pragma HLS array_partition variable=free_slot complete
+#pragma HLS reset variable=valid
+            assert(SIZE % GROUP == 0);
+            assert(STAGES >= 3);
+            for(int i = 0; i < SIZE; i++) {
+                keys[i] = 0;
+            }
+            clear();
+        }
+        void clear() {
+            valid = 0;
+            for(int i = 0; i < STAGES; i++) {
+#pragma HLS unroll
+                pipe[i].valid = false;
+                pipe[i].fwd = false;
+            }
+            free_any = 0;
+        }
+        // Advance the pipeline by one cycle.  If req_valid is true, then start
+        // processing req.  Return true if a request completes, along with its reply.
+        bool process(bool req_valid, const Request &req, Reply &reply) {
+#pragma HLS pipeline II=1
+#pragma HLS array_partition variable=pipe complete
+            // Final stage: select between groups and apply updates.
+            record &r = pipe[STAGES-1];
+            bool hit;
+            SlotT slot;
+            ValueT value;
+            if(r.fwd) {
+                hit = r.fwd_hit;
+                slot = r.fwd_slot;
+                value = r.fwd_value;
+            } else {
+                int g = priority_encode<GROUPS>(r.group_hit);
+                hit = r.group_hit != 0;
+                slot = g*GROUP + r.group_slot[g];
+                value = r.group_value[g];
+            }
+            bool done = r.valid;
+            bool update = false;
+            bool update_hit = false;
+            if(r.valid && r.req.op == INSERT) {
+                if(!hit) {
+                    // Take the lowest free entry.
+                    int g = priority_encode<GROUPS>(free_any);
+                    slot = g*GROUP + free_slot[g];
+                    hit = free_any != 0;
+                }
+                if(hit) {
+                    keys[slot] = r.req.key;
+                    values[slot] = r.req.value;
+                    valid[slot] = true;
+                    value = r.req.value;
+                    update = true;
+                    update_hit = true;
+                }
+            } else if(r.valid && r.req.op == REMOVE) {
+                if(hit) {
+                    valid[slot] = false;
+                    update = true;
+                }
+            }
+            reply.key = r.req.key;
+            reply.value = value;
+            reply.op = r.req.op;
+            reply.hit = hit;
+
+            // Forward updates to later requests for the same key.
+            for(int i = 0; i < STAGES-1; i++) {
+#pragma HLS unroll
+                if(update && pipe[i].valid && pipe[i].req.key == r.req.key) {
+                    pipe[i].fwd = true;
+                    pipe[i].fwd_hit = update_hit;
+                    pipe[i].fwd_slot = slot;
+                    pipe[i].fwd_value = r.req.value;
+                }
+            }
+
+            // Advance the pipeline.
+            for(int i = STAGES-1; i > 1; i--) {
+#pragma HLS unroll
+                pipe[i] = pipe[i-1];
+            }
+            // Stage 2: priority encode and select within each group.
+            for(int i = 0; i < GROUPS; i++) {
+#pragma HLS unroll
+                ap_uint<GROUP> m = pipe[1].matches(i*GROUP+GROUP-1, i*GROUP);
+                GroupSlotT s = priority_encode<GROUP>(m);
+                pipe[2].group_hit[i] = m != 0;
+                pipe[2].group_slot[i] = s;
+                pipe[2].group_value[i] = values[i*GROUP + s];
+            }
+            // Stage 1: match against every entry.
+            pipe[1] = pipe[0];
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS unroll
+                pipe[1].matches[i] = valid[i] && keys[i] == pipe[0].req.key;
+            }
+            pipe[0].valid = req_valid;
+            pipe[0].req = req;
+            pipe[0].fwd = false;
+
+            // Find the lowest free entry in each group for later inserts.
+            for(int i = 0; i < GROUPS; i++) {
+#pragma HLS unroll
+                ap_uint<GROUP> f = ~valid(i*GROUP+GROUP-1, i*GROUP);
+                free_any[i] = f != 0;
+                free_slot[i] = priority_encode<GROUP>(f);
+            }
+            return done;
+        }
+    };
+
+    // A key/value record, used to stream the contents of a table in or out.
+    // last is set on the final record of a stream.
+    template <typename KeyT, typename ValueT>
+    struct cam_record {
+        KeyT key;
+        ValueT value;
+        bool last;
+        cam_record(): key(0), value(0), last(false) {}
+        cam_record(KeyT key, ValueT value, bool last = false): key(key), value(value), last(last) {}
+    };
+
+    // Write value into an image as consecutive 32 bit words, starting at image[pos].
+    template <typename T>
+    void image_write(ap_uint<32> *image, int &pos, const T &value) {
+        const int WORDS = (Type_BitWidth<T>::Value+31)/32;
+        ap_uint<WORDS*32> bits = value;
+        for(int i = 0; i < WORDS; i++) {
+#pragma HLS pipeline II=1
+            image[pos++] = bits(32*i+31, 32*i);
+        }
+    }
+    // Read value from consecutive 32 bit words of an image, starting at image[pos].
+    template <typename T>
+    void image_read(const ap_uint<32> *image, int &pos, T &value) {
+        const int WORDS = (Type_BitWidth<T>::Value+31)/32;
+        ap_uint<WORDS*32> bits;
+        for(int i = 0; i < WORDS; i++) {
+#pragma HLS pipeline II=1
+            bits(32*i+31, 32*i) = image[pos++];
+        }
+        value = bits;
+    }
+
     template <int SIZE, int FACTOR, typename KeyT, typename ValueT>
     class algorithmic_cam;
 
@@ -291,26 +996,38 @@ namespace hls {
         const static int HASHBITS = BitWidth<BANKSIZE-1>::Value;
         const static int HASHESBITS = BitWidth<HASHES-1>::Value;
         const static int KEYBITS = Type_BitWidth<KeyT>::Value;
+        const static int AGEBITS = 4;
 
         typedef ap_uint<HASHBITS> HashT;
         typedef ap_uint<HASHESBITS> BankT;
+        typedef ap_uint<AGEBITS> AgeT;
 
         KeyT deleted_key;
         bool deleted_valid;
         cam<4, KeyT, ValueT> cache;
-        KeyT hashes[HASHBITS][HASHES];
+        h3_hash<KeyT, HASHBITS, HASHES> hasher;
         KeyT mem_key[BANKSIZE][HASHES];
         ValueT mem_value[BANKSIZE][HASHES];
         bool mem_valid[BANKSIZE][HASHES];
+        // Number of passes of the aging hand since each entry was
+        // last written (or last hit, if age_touch is set).
+        AgeT mem_age[BANKSIZE][HASHES];
+
+        // Aging configuration.  The aging hand visits one entry
+        // every age_period calls to age().  Entries which have been
+        // visited age_timeout times without being touched are
+        // evicted.  An age_timeout of zero disables aging.
+        ap_uint<32> age_period;
+        AgeT age_timeout;
+        bool age_touch;
+        ap_uint<32> age_count;
+        HashT age_row;
+        BankT age_bank;
+        // When nonzero, the aging hand is visiting cache entry age_slot-1.
+        ap_uint<3> age_slot;
 
         HashT hashfunction (const KeyT &key, int n) {
-            HashT t;
-            for(int i = 0; i < HASHBITS; i++) {
-                // Basically, each bit of the hash is created by selecting
-                // bits of the key, and then XORing them together.
-                KeyT select = key & hashes[i][n];
-                t[i] = select.xor_reduce();
-            }
+            HashT t = hasher.hash(key, n);
             assert(t>=0 && t<BANKSIZE);
             return t;
         }
@@ -350,66 +1067,56 @@ namespace hls {
             }
         }
 
-        template <int N>
-        ap_uint<N> random_permute(ap_uint<N> x) {
-            for (int i = N - 1; i >= 1; i--) {
-                /* 0 <= r <= i */
-                int r = JKISS() % (i+1);
-                bool temp = x[i];
-                x[i] = x[r];
-                x[r] = temp;
-            }
-            return x;
-        }
-        void init_hashes(KeyT hashes[HASHBITS][HASHES]) {
-            // Each bit of the key is selected by 50% of the hash bits.
-            // Each hash is randomly generated independently.
-            ap_uint<KEYBITS> x=0;
-            // Set half the bits of x.
-            for(int i = 0; i < KEYBITS/2; i++) {
-#pragma HLS unroll
-                x[i] = true;
-            }
-            for(int i = 0; i < HASHBITS; i++) {
-
-            	for(int j = 0; j < HASHES; j++) {
-                    // randomly shuffle x.
-                    x = random_permute(x);
-                    hashes[i][j] = x;
-                    // std::cout << "hashes[" << i << "][" << j << "]:"
-                    //           << hashes[i][j].toString(2, false) << "\n";
-                }
-            }
-        }
     public:
         algorithmic_cam() {
-            init_hashes(hashes);
-            #pragma HLS array_partition variable=hashes complete dim=0
             #pragma HLS array_partition variable=mem_key complete dim=2
             #pragma HLS array_partition variable=mem_value complete dim=2
             #pragma HLS array_partition variable=mem_valid complete dim=2
+            #pragma HLS array_partition variable=mem_age complete dim=2
             #pragma HLS reset variable=mem_valid
+            init();
+        }
+        void init() {
             for(int i = 0; i < BANKSIZE; i++) {
                 for(int j = 0; j < HASHES; j++) {
                     mem_valid[i][j] = false;
                     mem_key[i][j] = 0;
+                    mem_age[i][j] = 0;
                     //-mem_value[i][j] = 0;
                 }
             }
             deleted_valid = false;
+            age_period = 0;
+            age_timeout = 0;
+            age_touch = false;
+            age_count = 0;
+            age_row = 0;
+            age_bank = 0;
+            age_slot = 0;
+            sweep_state = 0;
+            sweep_valid = false;
+            sweep_deleting = false;
         }
         void clear() {
-            //            init_hashes(hashes);
+            //            hasher.init_hashes();
             for(int i = 0; i < BANKSIZE; i++) {
                 for(int j = 0; j < HASHES; j++) {
                     mem_valid[i][j] = false;
                 }
             }
             cache.clear();
+            deleted_valid = false;
+            sweep_state = 0;
+            sweep_valid = false;
+            sweep_deleting = false;
         }
         bool canInsert() {
             return cache.canInsert();
         }
+        // Return true if remove() can accept a new key.
+        bool canRemove() {
+            return !deleted_valid;
+        }
         bool get(const KeyT &key, ValueT &value) {
             #pragma HLS pipeline
             KeyT keys[HASHES];
@@ -422,7 +1129,14 @@ namespace hls {
             found &= valid;
 
             // FIXME: verify found should be one-hot.
-            if(cache.get(key, value)) return true;
+            if(cache.get(key, value)) {
+                if(age_touch) cache.reset_age(key);
+                return true;
+            }
+            if(age_touch && found != 0) {
+                BankT bank = convert_from_one_hot(found);
+                mem_age[hashes[bank]][bank] = 0;
+            }
             return parallel_select_basecase(value, found, values);
         }
 
@@ -474,9 +1188,10 @@ namespace hls {
         // #pragma HLS dependence variable=mem_valid inter false
             KeyT ikey;
             ValueT ivalue;
+            AgeT iage;
             bool ivalid;
             // select something out of the cam cache.
-            ivalid = cache.sweep(ikey, ivalue);
+            ivalid = cache.oldest(ikey, ivalue, iage);
             if(ivalid) {
                 KeyT keys[HASHES];
                 HashT hashes[HASHES];
@@ -493,338 +1208,156 @@ namespace hls {
                 HashT hash = hashes[i];
                 KeyT oldkey = keys[i];
                 ValueT oldvalue = values[i];
-                cache.swap(ikey, oldkey, oldvalue, collision); // The swap must happen with the following write.
+                AgeT oldage = mem_age[hash][i];
+                cache.swap(ikey, oldkey, oldvalue, collision, oldage); // The swap must happen with the following write.
                 mem_key[hash][i] = ikey;
                 mem_value[hash][i] = ivalue;
                 mem_valid[hash][i] = true;
-            } else {
-                cache.shift();
-            }
-            return ivalid;
-        }
-        struct work {
-            KeyT ikey;
-            ValueT ivalue;
-            KeyT oldkey;
-            ValueT oldvalue;
-            bool collision;
-            HashT hash;
-            BankT i;
-            bool valid;
-        };
-        struct work work0, work1, work2, work3, work4, work5, work6, work7, work8;
-        bool sweep1() {
-            #pragma HLS pipeline II=1
-            KeyT ikey;
-            ValueT ivalue;
-            bool ivalid;
-            // select something out of the cam cache.
-            work8 = work7;
-            work7 = work6;
-            work6 = work5;
-            work5 = work4;
-            work4 = work3;
-            work3 = work2;
-            work2 = work1;
-            work1 = work0;
-            work0.valid = false;
-            if(work8.valid) {
-                cache.swap(work8.ikey, work8.oldkey, work8.oldvalue, work8.collision); // The swap must happen with the following write.
-                mem_key[work8.hash][work8.i] = work8.ikey;
-                mem_value[work8.hash][work8.i] = work8.ivalue;
-                mem_valid[work8.hash][work8.i] = true;
-            } else {
-            ivalid = cache.sweep(ikey, ivalue);
-            if(ivalid) {
+                mem_age[hash][i] = iage;
+            } else if(deleted_valid) {
+                // Nothing to migrate, so complete a pending remove().
                 KeyT keys[HASHES];
                 HashT hashes[HASHES];
                 ValueT values[HASHES];
 
                 ap_uint<HASHES> found, valid;
-                lookup_all(ikey, keys, hashes, values, found, valid);
-
-                // handle possible collisions
-                BankT i;
-                // If there was a collision then oldvalid is false and we exit the loop
-                bool collision = pick_evict(found, valid, i); // ?
-                assert(i <= HASHES);
-                HashT hash = hashes[i];
-                KeyT oldkey = keys[i];
-                ValueT oldvalue = values[i];
-                work0.ikey = ikey;
-                work0.ivalue = ivalue;
-                work0.oldkey = oldkey;
-                work0.oldvalue = oldvalue;
-                work0.collision = collision;
-                work0.hash = hash;
-                work0.i = i;
-                work0.valid = true;
+                lookup_all(deleted_key, keys, hashes, values, found, valid);
+                cache.remove(deleted_key);
+                for(int i = 0; i < HASHES; i++) {
+#pragma HLS unroll
+                    if(found[i] && valid[i]) mem_valid[hashes[i]][i] = false;
+                }
+                deleted_valid = false;
             } else {
-                //cache.shift();
-            }
+                cache.shift();
             }
- 
             return ivalid;
         }
-        /*  struct work {
-            KeyT ikey;
-            ValueT ivalue;
-            KeyT oldkey;
-            ValueT oldvalue;
-            bool collision;
-            HashT hash;
-            BankT i;
-            bool valid;
-            };*/
-        bool sweep3() {
-            #pragma HLS pipeline II=1
-            KeyT ikey;
-            ValueT ivalue;
-            bool ivalid;
-            // select something out of the cam cache.
-             static KeyT ikey0, ikey1, ikey2, ikey3, ikey4, ikey5, ikey6, ikey7, ikey8;
-            ikey8 = ikey7;
-            ikey7 = ikey6;
-            ikey6 = ikey5;
-            ikey5 = ikey4;
-            ikey4 = ikey3;
-            ikey3 = ikey2;
-            ikey2 = ikey1;
-            ikey1 = ikey0;
-
-            static ValueT ivalue0, ivalue1, ivalue2, ivalue3, ivalue4, ivalue5, ivalue6, ivalue7, ivalue8;
-          ivalue8 = ivalue7;
-            ivalue7 = ivalue6;
-            ivalue6 = ivalue5;
-            ivalue5 = ivalue4;
-            ivalue4 = ivalue3;
-            ivalue3 = ivalue2;
-            ivalue2 = ivalue1;
-            ivalue1 = ivalue0;
-
-            static KeyT oldkey0, oldkey1, oldkey2, oldkey3, oldkey4, oldkey5, oldkey6, oldkey7, oldkey8;
-            oldkey8 = oldkey7;
-            oldkey7 = oldkey6;
-            oldkey6 = oldkey5;
-            oldkey5 = oldkey4;
-            oldkey4 = oldkey3;
-            oldkey3 = oldkey2;
-            oldkey2 = oldkey1;
-            oldkey1 = oldkey0;
-
-            static ValueT oldvalue0, oldvalue1, oldvalue2, oldvalue3, oldvalue4, oldvalue5, oldvalue6, oldvalue7, oldvalue8;
-            oldvalue8 = oldvalue7;
-            oldvalue7 = oldvalue6;
-            oldvalue6 = oldvalue5;
-            oldvalue5 = oldvalue4;
-            oldvalue4 = oldvalue3;
-            oldvalue3 = oldvalue2;
-            oldvalue2 = oldvalue1;
-            oldvalue1 = oldvalue0;
-  
-            static bool collision0, collision1, collision2, collision3, collision4, collision5, collision6, collision7, collision8;
-            collision8 = collision7;
-            collision7 = collision6;
-            collision6 = collision5;
-            collision5 = collision4;
-            collision4 = collision3;
-            collision3 = collision2;
-            collision2 = collision1;
-            collision1 = collision0;
-
-            static ValueT hash0, hash1, hash2, hash3, hash4, hash5, hash6, hash7, hash8;
-            hash8 = hash7;
-            hash7 = hash6;
-            hash6 = hash5;
-            hash5 = hash4;
-            hash4 = hash3;
-            hash3 = hash2;
-            hash2 = hash1;
-            hash1 = hash0;
-
-            static BankT i0, i1, i2, i3, i4, i5, i6, i7, i8;
-            i8 = i7;
-            i7 = i6;
-            i6 = i5;
-            i5 = i4;
-            i4 = i3;
-            i3 = i2;
-            i2 = i1;
-            i1 = i0;
-
-            static bool valid0, valid1, valid2, valid3, valid4, valid5, valid6, valid7, valid8;
-            valid8 = valid7;
-            valid7 = valid6;
-            valid6 = valid5;
-            valid5 = valid4;
-            valid4 = valid3;
-            valid3 = valid2;
-            valid2 = valid1;
-            valid1 = valid0;
-
-           valid0 = false;
-           if(valid8) {
-               cache.swap(ikey8, oldkey8, oldvalue8, collision8); // The swap must happen with the following write.
-                mem_key[hash8][i8] = ikey8;
-                mem_value[hash8][i8] = ivalue8;
-                mem_valid[hash8][i8] = true;
-            } else {
-            ivalid = cache.sweep(ikey, ivalue);
-            if(ivalid) {
-                KeyT keys[HASHES];
-                HashT hashes[HASHES];
-                ValueT values[HASHES];
-
-                ap_uint<HASHES> found, valid;
-                lookup_all(ikey, keys, hashes, values, found, valid);
-
-                // handle possible collisions
-                BankT i;
-                // If there was a collision then oldvalid is false and we exit the loop
-                bool collision = pick_evict(found, valid, i); // ?
-                assert(i <= HASHES);
-                HashT hash = hashes[i];
-                KeyT oldkey = keys[i];
-                ValueT oldvalue = values[i];
-                ikey0 = ikey;
-                ivalue0 = ivalue;
-                oldkey0 = oldkey;
-                oldvalue0 = oldvalue;
-                collision0 = collision;
-                hash0 = hash;
-                i0 = i;
-                valid0 = true;
-            } else {
-                //cache.shift();
-            }
-            }
- 
-            return ivalid;
+        // State of migrate().  In state 0 an entry has been selected and the
+        // banks read, and in state 1 the chosen bank is written.
+        int sweep_state;
+        KeyT sweep_key;
+        ValueT sweep_value;
+        AgeT sweep_age;
+        bool sweep_valid;
+        bool sweep_deleting;
+        // Set if the key being deleted is inserted again before the remove()
+        // completes, in which case the new cache entry must be kept.
+        bool sweep_reinserted;
+        HashT sweep_hash;
+        BankT sweep_bank;
+        // The entry previously stored at [sweep_hash][sweep_bank].
+        KeyT sweep_oldkey;
+        ValueT sweep_oldvalue;
+        AgeT sweep_oldage;
+        bool sweep_found;
+        bool sweep_collision;
+
+        // Return true if migrate() has read the banks for an entry
+        // which it has not yet written back.
+        bool migrating() const {
+            return sweep_state != 0 && (sweep_valid || sweep_deleting);
         }
 
-        bool sweep2() {
-        // #pragma HLS dependence variable=mem_key inter false
-        // #pragma HLS dependence variable=mem_value inter false
-        // #pragma HLS dependence variable=mem_valid inter false
-            static KeyT ikey;
-            static ValueT ivalue;
-            static bool ivalid;
-            static int state;
-
-            static KeyT keys[HASHES];
-            static HashT hashes[HASHES];
-            static ValueT values[HASHES];
-            static KeyT keys2[HASHES];
-            static HashT hashes2[HASHES];
-            static ValueT values2[HASHES];
-#pragma HLS array_partition variable=keys2 complete
-#pragma HLS array_partition variable=hashes2 complete
-#pragma HLS array_partition variable=values2 complete
-
-            static ap_uint<HASHES> found, valid;
-            static ap_uint<HASHES> found2, valid2;
-            // handle possible collisions
-            static BankT bank;
-
-            static BankT bank2;
-            static BankT bank3;
-            // If there was a collision then oldvalid is false and we exit the loop
-            static bool collision;
-            static HashT hash;
-            static KeyT oldkey;
-            static ValueT oldvalue;
-            static bool deleting;
-            BankT b;
-            switch(state) {
-            case 0:
+        // Move one entry from the cache into the banks, or complete a pending
+        // remove().  Each call performs at most one access to each bank (either a
+        // read or a write), so this can be called every cycle with II=1 alongside
+        // get(), using the second port of the bank memories.  The banks are read
+        // in one call and the chosen bank is written in the next, so a migration
+        // completes every 2 calls, which is the most that one port allows.
+        bool migrate() {
+#pragma HLS inline
+            if(sweep_state == 0) {
                 // select something out of the cam cache.
-                ivalid = cache.sweep(ikey, ivalue);
-                if(!ivalid) { ikey=deleted_key; ivalue = 0x0; deleting = deleted_valid;
-
-                } else { deleting = false; }
-
-#ifdef DEBUG
-                if(ivalid) std::cout << "Sweep Select " << ikey << "->" << ivalue << "\n";
-                if(deleting) std::cout << "Sweep Delete " << ikey;
-#endif
-                cache.shift();
-                state = 1;
-                break;
-            case 1:
-                if(ivalid || deleting) {
-                    for(int i = 0; i < HASHES; i++) {
-                        HashT hash = hashfunction(ikey,i);
-                        hashes[i] = hash;
-                    }
-                //                    lookup_all(ikey, keys, hashes, values, found, valid);
+                sweep_valid = cache.oldest(sweep_key, sweep_value, sweep_age);
+                if(!sweep_valid) {
+                    sweep_key = deleted_key;
+                    sweep_value = ValueT();
+                    sweep_deleting = deleted_valid;
+                } else {
+                    sweep_deleting = false;
+                }
+                sweep_reinserted = false;
+                if(!sweep_valid && !sweep_deleting) return false;
 #ifdef DEBUG
-                    std::cout << "Sweep Lookup " << ikey << " is valid.\n";
+                if(sweep_valid) std::cout << "Sweep Select " << sweep_key << "->" << sweep_value << "\n";
+                if(sweep_deleting) std::cout << "Sweep Delete " << sweep_key << "\n";
 #endif
-                }
-                state = 2;
-                break;
-            case 2:
+                KeyT keys[HASHES];
+                HashT hashes[HASHES];
+                ValueT values[HASHES];
+                AgeT ages[HASHES];
+                ap_uint<HASHES> found, occupied;
                 for(int i = 0; i < HASHES; i++) {
-                    HashT hash = hashes[i];
-                    KeyT storedkey =
-                    keys2[i] = mem_key[hash][i];
-                    values2[i] = mem_value[hash][i];
-                    found2[i] = ikey == storedkey;
-                    valid2[i] = mem_valid[hash][i];
-                    hashes2[i] = hash;
-                }
-                // for(int i = 0; i < HASHES; i++) {
-                //     keys2[i] = keys[i];
-                //     hashes2[i] = hashes[i];
-                //     values2[i] = values[i];
-                // }
-                // found2 = found;
-                // valid2 = valid;
-                state = 3;
-                break;
-            case 3:
-                if(ivalid || deleting) {
-                    collision = pick_evict(found2, valid2, b) && !deleting; // ?
-                    bank = 4;
+                    HashT hash = hashfunction(sweep_key, i);
+                    hashes[i] = hash;
+                    keys[i] = mem_key[hash][i];
+                    values[i] = mem_value[hash][i];
+                    ages[i] = mem_age[hash][i];
+                    found[i] = sweep_key == keys[i];
+                    occupied[i] = mem_valid[hash][i];
+                }
+                BankT b;
+                sweep_collision = pick_evict(found, occupied, b) && sweep_valid;
+                assert(b <= HASHES);
+                sweep_bank = b;
+                sweep_hash = hashes[b];
+                sweep_oldkey = keys[b];
+                sweep_oldvalue = values[b];
+                sweep_oldage = ages[b];
+                sweep_found = found[b] && occupied[b];
 #ifdef DEBUG
-                    std::cout << "Sweep Evict " << ikey << " to [" << bank << "][" << hashes2[bank] << "]";
-                    if(collision) std::cout << " collides with " << keys2[bank] << "\n";
-                    else std::cout << " no collision\n";
+                std::cout << "Sweep Evict " << sweep_key << " to [" << sweep_bank << "][" << sweep_hash << "]";
+                if(sweep_collision) std::cout << " collides with " << sweep_oldkey << "\n";
+                else std::cout << " no collision\n";
 #endif
-                    assert(bank <= HASHES);
-                }
-                state = 4;
-                break;
-            case 4:
-                bank2 = bank;
-                state = 5;
-                break;
-            case 5:
-                bank3 = bank2;
-                state = 6;
-                break;
-            case 6:
-                if(ivalid || deleting) {
-                    hash = hashes2[bank2];
-                    KeyT oldkey = keys2[bank2];
-                    ValueT oldvalue = values2[bank2];
-                    bool b = cache.swap(ikey, oldkey, oldvalue, collision); // The swap must happen simultaneously with the following write.
-                    mem_key[hash][bank2] = ikey;
-                    mem_value[hash][bank2] = ivalue;
-                    mem_valid[hash][bank2] = ivalid;
-                    if(deleting) deleted_valid = false;
+                sweep_state = 1;
+            } else {
+                if(sweep_valid || (sweep_deleting && !sweep_reinserted)) {
+                    // The swap must happen simultaneously with the following write.
+                    cache.swap(sweep_key, sweep_oldkey, sweep_oldvalue, sweep_collision, sweep_oldage);
+                }
+                if(sweep_valid) {
+                    mem_key[sweep_hash][sweep_bank] = sweep_key;
+                    mem_value[sweep_hash][sweep_bank] = sweep_value;
+                    mem_valid[sweep_hash][sweep_bank] = true;
+                    mem_age[sweep_hash][sweep_bank] = sweep_age;
+                } else if(sweep_deleting) {
+                    // Only clear the bank entry if it holds the deleted key.
+                    if(sweep_found) {
+                        mem_valid[sweep_hash][sweep_bank] = false;
+                    }
+                    deleted_valid = false;
+                }
 #ifdef DEBUG
-                    std::cout << "Sweep Writeback " << ikey << " evicted " << oldkey << "->" << oldvalue << "\n";
-                    std::cout << *this << "\n";
+                std::cout << "Sweep Writeback " << sweep_key << " evicted " << sweep_oldkey << "->" << sweep_oldvalue << "\n";
+                std::cout << *this << "\n";
 #endif
-                }
-                state = 0;
-                break;
+                sweep_state = 0;
             }
-            return ivalid;
+            return sweep_valid;
+        }
+        bool sweep2() {
+            return migrate();
         }
         bool insert(const KeyT &key, const ValueT &value) {
-            return cache.insert(key, value);
+            if(!cache.insert(key, value)) return false;
+            // An entry being migrated is removed from the cache when it is
+            // written back, so forward the new value to the migration.
+            if(migrating() && sweep_valid && sweep_key == key) {
+                sweep_value = value;
+                sweep_age = 0;
+            }
+            // A new entry for a key with a pending remove() replaces it.
+            if(deleted_valid && deleted_key == key) {
+                if(migrating() && sweep_deleting) {
+                    sweep_reinserted = true;
+                } else {
+                    // The old entry in the banks is replaced when the new one is migrated.
+                    deleted_valid = false;
+                }
+            }
+            return true;
         }
         bool insert_nocache(const KeyT &key, const ValueT &value) {
             KeyT ikey = key;
@@ -851,6 +1384,7 @@ namespace hls {
                 mem_key[hash][i] = ikey;
                 mem_value[hash][i] = ivalue;
                 mem_valid[hash][i] = true;
+                mem_age[hash][i] = 0;
                 ikey = oldkey;
                 ivalue = oldvalue;
                 ivalid = collision;
@@ -882,6 +1416,314 @@ namespace hls {
             return true;
         }
 
+        // Configure entry aging.  The aging hand visits one entry every
+        // 'period' calls to age(), covering the banks and then the cache, so an
+        // entry which is not touched is evicted after roughly
+        // period*(BANKSIZE*HASHES+4)*timeout calls.  If touch_on_hit
+        // is set, then a successful get() also resets the age of the entry.
+        // A timeout of zero disables aging.
+        void set_aging(ap_uint<32> period, AgeT timeout, bool touch_on_hit) {
+            age_period = period;
+            age_timeout = timeout;
+            age_touch = touch_on_hit;
+        }
+        // Advance the aging hand.  This is intended to be called once per cycle
+        // alongside sweep().  If an entry is evicted, then return true along with the
+        // evicted key and value, otherwise return false.
+        bool age(KeyT &key, ValueT &value) {
+            if(age_timeout == 0) return false;
+            if(age_count + 1 < age_period) {
+                age_count++;
+                return false;
+            }
+            // Don't race with an entry which is being migrated into the banks.
+            if(migrating()) return false;
+            age_count = 0;
+
+            if(age_slot != 0) {
+                int slot = age_slot - 1;
+                age_slot = (slot == 3) ? 0 : age_slot + 1;
+                bool evicted = cache.age_entry(slot, age_timeout, key, value);
+#ifdef DEBUG
+                if(evicted) std::cout << "Age Evict " << key << "->" << value << " from cache[" << slot << "]\n";
+#endif
+                return evicted;
+            }
+
+            HashT row = age_row;
+            BankT bank = age_bank;
+            if(bank == HASHES-1) {
+                age_bank = 0;
+                if(row == BANKSIZE-1) {
+                    age_row = 0;
+                    age_slot = 1;
+                } else {
+                    age_row++;
+                }
+            } else {
+                age_bank++;
+            }
+
+            if(!mem_valid[row][bank]) return false;
+            AgeT a = mem_age[row][bank] + 1;
+            if(a >= age_timeout) {
+                key = mem_key[row][bank];
+                value = mem_value[row][bank];
+                mem_valid[row][bank] = false;
+#ifdef DEBUG
+                std::cout << "Age Evict " << key << "->" << value << " from [" << row << "][" << bank << "]\n";
+#endif
+                return true;
+            }
+            mem_age[row][bank] = a;
+            return false;
+        }
+
+        typedef cam_record<KeyT, ValueT> RecordT;
+        // Maximum number of displacements when placing an entry in bulk_load().
+        const static int MAX_KICKS = 16;
+
+        // Load a stream of records, terminated by a record with last set,
+        // directly into the banks, replacing any existing entries with the
+        // same keys.  Entries are placed at roughly one per cycle until the
+        // table is close to full.  An entry which cannot be placed within
+        // MAX_KICKS displacements is left in the cache, if possible.
+        // Return the number of records which could not be loaded.
+        int bulk_load(hls::stream<RecordT> &in) {
+            int failed = 0;
+            KeyT ikey;
+            ValueT ivalue;
+            bool ivalid = false;
+            bool last = false;
+            int kicks = 0;
+        bulk_load_loop:
+            while(!last || ivalid) {
+#pragma HLS pipeline
+                if(!ivalid) {
+                    RecordT r = in.read();
+                    ikey = r.key;
+                    ivalue = r.value;
+                    last = r.last;
+                    ivalid = true;
+                    kicks = 0;
+                    cache.remove(ikey);
+                }
+                KeyT keys[HASHES];
+                HashT hashes[HASHES];
+                ValueT values[HASHES];
+
+                ap_uint<HASHES> found, valid;
+                lookup_all(ikey, keys, hashes, values, found, valid);
+
+                BankT i;
+                bool collision = pick_evict(found, valid, i);
+                HashT hash = hashes[i];
+                mem_key[hash][i] = ikey;
+                mem_value[hash][i] = ivalue;
+                mem_valid[hash][i] = true;
+                mem_age[hash][i] = 0;
+                ikey = keys[i];
+                ivalue = values[i];
+                ivalid = collision;
+                kicks++;
+                if(ivalid && kicks == MAX_KICKS) {
+                    if(!cache.insert(ikey, ivalue)) failed++;
+                    ivalid = false;
+                }
+            }
+            // Select and read the banks again for any migration in flight.
+            sweep_state = 0;
+            return failed;
+        }
+
+        // Write every valid entry to out, setting last on the final record.
+        // Return the number of records written.
+        int dump(hls::stream<RecordT> &out) {
+            int count = 0;
+            RecordT held;
+            bool held_valid = false;
+        dump_cache_loop:
+            for(int i = 0; i < 4; i++) {
+#pragma HLS pipeline II=1
+                KeyT key;
+                ValueT value;
+                if(cache.get_entry(i, key, value) && !(deleted_valid && key == deleted_key)) {
+                    if(held_valid) out.write(held);
+                    held = RecordT(key, value);
+                    held_valid = true;
+                    count++;
+                }
+            }
+        dump_bank_loop:
+            for(int i = 0; i < BANKSIZE; i++) {
+                for(int j = 0; j < HASHES; j++) {
+#pragma HLS pipeline II=1
+                    KeyT key = mem_key[i][j];
+                    ValueT value;
+                    // Entries in the cache are newer than entries in the banks.
+                    if(mem_valid[i][j] && !cache.get(key, value) &&
+                       !(deleted_valid && key == deleted_key)) {
+                        if(held_valid) out.write(held);
+                        held = RecordT(key, mem_value[i][j]);
+                        held_valid = true;
+                        count++;
+                    }
+                }
+            }
+            if(held_valid) {
+                held.last = true;
+                out.write(held);
+            }
+            return count;
+        }
+
+        // Remove every entry for which pred(key, value) returns true.
+        // Return the number of entries removed.
+        template <typename Pred>
+        int clear_if(Pred &pred) {
+            int count = cache.clear_if(pred);
+            // Select and read the banks again for any migration in flight,
+            // after they have been cleared.
+            sweep_state = 0;
+        clear_if_loop:
+            for(int i = 0; i < BANKSIZE; i++) {
+                for(int j = 0; j < HASHES; j++) {
+#pragma HLS pipeline II=1
+                    if(mem_valid[i][j] && pred(mem_key[i][j], mem_value[i][j])) {
+                        mem_valid[i][j] = false;
+                        count++;
+                    }
+                }
+            }
+            return count;
+        }
+
+        // Images written by save() start with this word.
+        const static int IMAGE_MAGIC = 0x43414d31;
+        const static int VALUEBITS = Type_BitWidth<ValueT>::Value;
+        const static int KEYWORDS = (KEYBITS+31)/32;
+        const static int VALUEWORDS = (VALUEBITS+31)/32;
+        // The largest image which can be written by save().
+        const static int MAX_IMAGE_WORDS = 5 + HASHBITS*HASHES*KEYWORDS +
+            1 + 4*(KEYWORDS+VALUEWORDS) + (BANKSIZE*HASHES+31)/32 + BANKSIZE*HASHES*(KEYWORDS+VALUEWORDS);
+
+        // Write a snapshot of the table, including the hash functions, to image.
+        // The image consists of:
+        // a header of IMAGE_MAGIC, SIZE, FACTOR, KEYBITS and VALUEBITS,
+        // the hash masks,
+        // the number of cached entries, followed by their keys and values,
+        // a bitmap of the valid bank entries, in row-major order,
+        // and the key and value of each valid bank entry, in the same order.
+        // Any pending remove() is applied to the snapshot.
+        // Return the number of words written.
+        int save(ap_uint<32> *image) {
+            int pos = 0;
+            image[pos++] = IMAGE_MAGIC;
+            image[pos++] = SIZE;
+            image[pos++] = FACTOR;
+            image[pos++] = KEYBITS;
+            image[pos++] = VALUEBITS;
+            for(int i = 0; i < HASHBITS; i++) {
+                for(int j = 0; j < HASHES; j++) {
+                    image_write(image, pos, hasher.hashes[i][j]);
+                }
+            }
+            int countpos = pos++;
+            int count = 0;
+            for(int i = 0; i < 4; i++) {
+                KeyT key;
+                ValueT value;
+                if(cache.get_entry(i, key, value) && !(deleted_valid && key == deleted_key)) {
+                    image_write(image, pos, key);
+                    image_write(image, pos, value);
+                    count++;
+                }
+            }
+            image[countpos] = count;
+            // Write the bitmap
+            ap_uint<32> bitmap = 0;
+            int bit = 0;
+            for(int i = 0; i < BANKSIZE; i++) {
+                for(int j = 0; j < HASHES; j++) {
+#pragma HLS pipeline II=1
+                    bitmap[bit] = mem_valid[i][j] && !(deleted_valid && mem_key[i][j] == deleted_key);
+                    if(bit == 31 || (i == BANKSIZE-1 && j == HASHES-1)) {
+                        image[pos++] = bitmap;
+                        bitmap = 0;
+                        bit = 0;
+                    } else {
+                        bit++;
+                    }
+                }
+            }
+            for(int i = 0; i < BANKSIZE; i++) {
+                for(int j = 0; j < HASHES; j++) {
+                    if(mem_valid[i][j] && !(deleted_valid && mem_key[i][j] == deleted_key)) {
+                        image_write(image, pos, mem_key[i][j]);
+                        image_write(image, pos, mem_value[i][j]);
+                    }
+                }
+            }
+            return pos;
+        }
+
+        // Replace the contents of the table, including the hash functions,
+        // with an image written by save().
+        // Return true if the image was restored, or false if it was written
+        // by a table with different parameters.
+        bool restore(const ap_uint<32> *image) {
+            int pos = 0;
+            if(image[0] != IMAGE_MAGIC || image[1] != SIZE || image[2] != FACTOR ||
+               image[3] != KEYBITS || image[4] != VALUEBITS) {
+                return false;
+            }
+            pos = 5;
+            clear();
+            for(int i = 0; i < HASHBITS; i++) {
+                for(int j = 0; j < HASHES; j++) {
+                    image_read(image, pos, hasher.hashes[i][j]);
+                }
+            }
+            int count = image[pos++];
+            for(int i = 0; i < count; i++) {
+                KeyT key;
+                ValueT value;
+                image_read(image, pos, key);
+                image_read(image, pos, value);
+                cache.insert(key, value);
+            }
+            int bitmappos = pos;
+            pos += (BANKSIZE*HASHES+31)/32;
+            ap_uint<32> bitmap;
+            int bit = 0;
+            for(int i = 0; i < BANKSIZE; i++) {
+                for(int j = 0; j < HASHES; j++) {
+                    if(bit == 0) bitmap = image[bitmappos++];
+                    bool v = bitmap[bit];
+                    bit = (bit == 31) ? 0 : bit+1;
+                    if(v) {
+                        image_read(image, pos, mem_key[i][j]);
+                        image_read(image, pos, mem_value[i][j]);
+                    }
+                    mem_valid[i][j] = v;
+                    mem_age[i][j] = 0;
+                }
+            }
+            return true;
+        }
+
+        // Construct a table from an image written by save().
+        algorithmic_cam(const ap_uint<32> *image) {
+            #pragma HLS array_partition variable=mem_key complete dim=2
+            #pragma HLS array_partition variable=mem_value complete dim=2
+            #pragma HLS array_partition variable=mem_valid complete dim=2
+            #pragma HLS array_partition variable=mem_age complete dim=2
+            #pragma HLS reset variable=mem_valid
+            init();
+            bool b = restore(image);
+            assert(b);
+        }
+
         friend std::ostream& operator<< <SIZE, FACTOR, KeyT, ValueT>(std::ostream& os,
                                                                      const algorithmic_cam<SIZE, FACTOR, KeyT, ValueT>& cam);
         };
@@ -901,6 +1743,332 @@ namespace hls {
         return os;
     }
 
+    // An algorithmic_cam which supports PORTS independent lookups per cycle.
+    // The table is replicated PORTS times and each replica serves one lookup
+    // per cycle from the first port of its BRAM banks.  Each lookup port has
+    // its own copy of the hash logic.  Updates are applied to every replica
+    // through a dedicated update port which only touches the (register-based)
+    // stash.  migrate() runs on every replica in every cycle using the second
+    // BRAM port, so updates are migrated into the banks even when every
+    // lookup port is busy.  This uses twice the memory of serving two lookups
+    // from each replica, which would leave no port free for migration.
+    template <int SIZE, int FACTOR, int PORTS, typename KeyT, typename ValueT>
+    class multiport_algorithmic_cam {
+    public:
+        // Each replica serves one lookup port from the first port of its
+        // bank memories, leaving the second port free for migrate().
+        const static int REPLICAS = PORTS;
+        typedef algorithmic_cam<SIZE, FACTOR, KeyT, ValueT> ReplicaT;
+
+        ReplicaT replicas[REPLICAS];
+
+        multiport_algorithmic_cam() {
+#pragma HLS array_partition variable=replicas complete
+        }
+        void clear() {
+            for(int r = 0; r < REPLICAS; r++) {
+#pragma HLS unroll
+                replicas[r].clear();
+            }
+        }
+        bool canInsert() {
+            bool b = true;
+            for(int r = 0; r < REPLICAS; r++) {
+#pragma HLS unroll
+                b = b && replicas[r].canInsert();
+            }
+            return b;
+        }
+        // Lookup the key on the given port.
+        bool get(int port, const KeyT &key, ValueT &value) {
+            return replicas[port].get(key, value);
+        }
+        // Perform a lookup for every port which has its bit set in 'valid'.
+        // Return a flag for each port indicating whether the corresponding
+        // lookup hit.
+        ap_uint<PORTS> get_all(const KeyT keys[PORTS], ValueT values[PORTS], ap_uint<PORTS> valid) {
+#pragma HLS array_partition variable=keys complete
+#pragma HLS array_partition variable=values complete
+            ap_uint<PORTS> hits = 0;
+            for(int p = 0; p < PORTS; p++) {
+#pragma HLS unroll
+                if(valid[p]) {
+                    hits[p] = replicas[p].get(keys[p], values[p]);
+                }
+            }
+            return hits;
+        }
+        bool insert(const KeyT &key, const ValueT &value) {
+            if(!canInsert()) return false;
+            for(int r = 0; r < REPLICAS; r++) {
+#pragma HLS unroll
+                replicas[r].insert(key, value);
+            }
+            return true;
+        }
+        bool remove(const KeyT &key) {
+            for(int r = 0; r < REPLICAS; r++) {
+#pragma HLS unroll
+                if(replicas[r].deleted_valid) return false;
+            }
+            for(int r = 0; r < REPLICAS; r++) {
+#pragma HLS unroll
+                replicas[r].remove(key);
+            }
+            return true;
+        }
+        // Migrate entries from the stash into the banks.  This is intended
+        // to be called every cycle alongside get_all().
+        void migrate() {
+            for(int r = 0; r < REPLICAS; r++) {
+#pragma HLS unroll
+                replicas[r].migrate();
+            }
+        }
+    };
+
+    // A value held in the on-chip level of a two_level_cam, along with
+    // whether it has been modified since it was read from external memory.
+    template <typename ValueT>
+    struct cached_value {
+        ValueT value;
+        bool dirty;
+        cached_value(): value(0), dirty(false) {}
+        cached_value(const ValueT &v, bool d): value(v), dirty(d) {}
+    };
+    template <typename ValueT>
+    std::ostream& operator<<(std::ostream& os, const cached_value<ValueT>& v) {
+        return os << v.value << (v.dirty ? "*" : "");
+    }
+
+    // A hash table with SIZE entries stored in external memory, with an on-chip
+    // algorithmic_cam of CACHESIZE entries caching recently used entries.
+    // The external table is organized as SIZE/WAYS buckets of WAYS entries.
+    // Each bucket is stored contiguously, so that a bucket can be read or written
+    // in a single burst.  Each key can be stored in one of two buckets, selected
+    // by independent hashes.  The external memory is passed to each operation,
+    // enabling it to be mapped to an m_axi interface (or a plain array in C-sim).
+    // Updates are held in the cache and written back when the entry is aged out
+    // of the cache by sweep().  When the cache is full, updates are written
+    // directly to external memory instead.
+    // SIZE, WAYS and CACHESIZE are powers of 2.
+    template <int SIZE, int WAYS, int CACHESIZE, typename KeyT, typename ValueT>
+    class two_level_cam {
+    public:
+        const static int BUCKETS = SIZE/WAYS;
+        const static int BUCKETBITS = BitWidth<BUCKETS-1>::Value;
+        const static int CHOICES = 2;
+        typedef ap_uint<BUCKETBITS> BucketT;
+        typedef cached_value<ValueT> CachedValueT;
+        typedef algorithmic_cam<CACHESIZE, 4, KeyT, CachedValueT> CacheT;
+
+        struct entry {
+            KeyT key;
+            ValueT value;
+            bool valid;
+        };
+
+        CacheT cache;
+        h3_hash<KeyT, BUCKETBITS, CHOICES> hasher;
+        // An entry which could not be written back, waiting to be
+        // returned to the cache.
+        KeyT pending_key;
+        CachedValueT pending_value;
+        bool pending_valid;
+        // Number of write-backs which failed because both buckets were full.
+        int overflows;
+
+        // By default, an entry which is not used for two passes of the aging
+        // hand is aged out of the cache.
+        const static int DEFAULT_AGE_PERIOD = 1;
+        const static int DEFAULT_AGE_TIMEOUT = 2;
+
+        two_level_cam() {
+            pending_valid = false;
+            overflows = 0;
+            set_aging(DEFAULT_AGE_PERIOD, DEFAULT_AGE_TIMEOUT);
+        }
+        // Initialize the external table.
+        void clear(entry *mem) {
+            for(int i = 0; i < SIZE; i++) {
+#pragma HLS pipeline II=1
+                mem[i].valid = false;
+            }
+            cache.clear();
+            pending_valid = false;
+        }
+        // Configure how long entries stay in the cache when they are not used.
+        // See algorithmic_cam::set_aging().  Since modified entries are only
+        // written back as they age out, the timeout should not be zero.
+        void set_aging(ap_uint<32> period, typename CacheT::AgeT timeout) {
+            cache.set_aging(period, timeout, true);
+        }
+        // Read the buckets associated with key from external memory.
+        // Return the address of the entry containing key, or -1 if it is not present.
+        // In addition, return the address of a free entry in the least loaded
+        // bucket, or -1 if the buckets are full.
+        int read_buckets(const KeyT &key, entry *mem, entry &found_entry, int &free_address) {
+            int found = -1;
+            int most_free = 0;
+            free_address = -1;
+            for(int c = 0; c < CHOICES; c++) {
+                int offset = hasher.hash(key, c)*WAYS;
+                entry ways[WAYS];
+            read_bucket_loop:
+                for(int i = 0; i < WAYS; i++) {
+#pragma HLS pipeline II=1
+                    ways[i] = mem[offset+i];
+                }
+                int free_count = 0;
+                int free_way = 0;
+                for(int i = WAYS-1; i >= 0; i--) {
+#pragma HLS unroll
+                    if(ways[i].valid && ways[i].key == key) {
+                        found = offset+i;
+                        found_entry = ways[i];
+                    }
+                    if(!ways[i].valid) {
+                        free_count++;
+                        free_way = i;
+                    }
+                }
+                if(free_count > most_free) {
+                    most_free = free_count;
+                    free_address = offset+free_way;
+                }
+            }
+            return found;
+        }
+        // Write an entry into external memory, replacing
+        // any existing entry with the same key.
+        // Return true if the operation succeeds or false if the buckets are full.
+        bool write_back(const KeyT &key, const ValueT &value, entry *mem) {
+            entry e;
+            int free_address;
+            int address = read_buckets(key, mem, e, free_address);
+            if(address < 0) address = free_address;
+            if(address < 0) {
+                overflows++;
+                return false;
+            }
+            e.key = key;
+            e.value = value;
+            e.valid = true;
+            mem[address] = e;
+            return true;
+        }
+        // Retrieve the value associated with the given key.  If the key is not
+        // in the cache, then read it from external memory and cache it.
+        // Return true if there is such a value, or false if there is no such value.
+        bool get(const KeyT &key, ValueT &value, entry *mem) {
+            CachedValueT cv;
+            if(cache.get(key, cv)) {
+                value = cv.value;
+                return true;
+            }
+            if(pending_valid && pending_key == key) {
+                value = pending_value.value;
+                return true;
+            }
+            entry e;
+            int free_address;
+            if(read_buckets(key, mem, e, free_address) < 0) return false;
+            value = e.value;
+            if(cache.canInsert()) {
+                cache.insert(key, CachedValueT(value, false));
+            }
+            return true;
+        }
+        // Add a new entry with the given key and value.  If an entry
+        // already exists with the given key, then it is replaced.
+        // The entry is written to external memory when it leaves the cache,
+        // or immediately if the cache is full.
+        // Return true if the operation succeeds or false if it fails.
+        bool insert(const KeyT &key, const ValueT &value, entry *mem) {
+            if(cache.canInsert()) {
+                return cache.insert(key, CachedValueT(value, true));
+            }
+            // A cached copy of the entry would become stale, so retry once
+            // it has been aged out.
+            CachedValueT cv;
+            if(cache.get(key, cv) || (pending_valid && pending_key == key)) {
+                return false;
+            }
+            return write_back(key, value, mem);
+        }
+        // Remove the value associated with the given key.
+        // Return true if the remove was accepted, or false if it should be retried.
+        bool remove(const KeyT &key, entry *mem) {
+            if(pending_valid && pending_key == key) return false;
+            if(!cache.remove(key)) return false;
+            entry e;
+            int free_address;
+            int address = read_buckets(key, mem, e, free_address);
+            if(address >= 0) {
+                mem[address].valid = false;
+            }
+            return true;
+        }
+        // Perform background maintenance of the cache: migrate new entries
+        // into the cache and write back modified entries as they are aged out.
+        // If an entry cannot be written back, then it is returned to the cache.
+        void sweep(entry *mem) {
+            cache.sweep();
+            if(pending_valid) {
+                if(cache.canInsert()) {
+                    cache.insert(pending_key, pending_value);
+                    pending_valid = false;
+                }
+                return;
+            }
+            KeyT key;
+            CachedValueT cv;
+            if(cache.age(key, cv) && cv.dirty) {
+                if(!write_back(key, cv.value, mem)) {
+                    pending_key = key;
+                    pending_value = cv;
+                    pending_valid = true;
+                }
+            }
+        }
+        // Write back all modified entries in the cache, including those
+        // still in its insertion cache and the pending entry, leaving them in
+        // the cache, but clean.
+        void flush(entry *mem) {
+        flush_bank_loop:
+            for(int i = 0; i < CacheT::BANKSIZE; i++) {
+                for(int j = 0; j < CacheT::HASHES; j++) {
+#pragma HLS pipeline II=1
+                    if(cache.mem_valid[i][j] && cache.mem_value[i][j].dirty) {
+                        if(write_back(cache.mem_key[i][j], cache.mem_value[i][j].value, mem)) {
+                            cache.mem_value[i][j].dirty = false;
+                        }
+                    }
+                }
+            }
+            // Entries in the insertion cache are newer than entries in the
+            // banks, so they are written back last.
+        flush_cache_loop:
+            for(int i = 0; i < 4; i++) {
+#pragma HLS pipeline II=1
+                KeyT key;
+                CachedValueT cv;
+                if(cache.cache.get_entry(i, key, cv) && cv.dirty &&
+                   !(cache.deleted_valid && key == cache.deleted_key)) {
+                    if(write_back(key, cv.value, mem)) {
+                        cv.dirty = false;
+                        cache.cache.set_value(i, cv);
+                    }
+                }
+            }
+            if(pending_valid && pending_value.dirty) {
+                if(write_back(pending_key, pending_value.value, mem)) {
+                    pending_value.dirty = false;
+                }
+            }
+        }
+    };
+
 template <int _N, typename _KeyT, typename _ValueT, typename _LookupSourceT = ap_uint<1>, typename _UpdateSourceT=ap_uint<1> >
 class SmartCam {
 public:
@@ -949,6 +2117,165 @@ struct UpdateReply {
 	UpdateReply(ValueT id, ap_uint<1> op)
         :value(id), op(op), source(0) {}
 };
+// The table shared by all of the top level functions.
+static hls::algorithmic_cam<N, 4, KeyT, ValueT> &table() {
+    static hls::algorithmic_cam<N, 4, KeyT, ValueT> mycam;
+    return mycam;
+}
+
+// Default arbiter configuration used by top().
+static const int DEFAULT_UPDATE_PERIOD = 8;
+static const int DEFAULT_UPDATE_BATCH = 1;
+
+// Process one request from the given streams.  Lookups from several
+// sources are served in weighted round-robin order: once a source is
+// selected it may issue up to weights[i] lookups before the next source
+// with pending requests is selected.  Updates are served when no lookups
+// are pending, and additionally once updates have been waiting for
+// update_period cycles, so updates are never starved by lookups.  An
+// update_period of zero gives lookups strict priority.  Once an update is
+// granted, up to update_batch updates are processed back to back.  An
+// update_batch of zero is treated as one.
+// New entries are migrated from the cache into the table in the
+// background, concurrently with lookups, so that the cache does not
+// fill up under a sustained lookup load.
+// The source field of each request is returned in the corresponding reply.
+template <int SOURCES>
+static void arbitrated_top(hls::stream<LookupRequest> LookupReq[SOURCES],
+                           hls::stream<LookupReply> LookupResp[SOURCES],
+                           hls::stream<UpdateRequest> &UpdateReq,
+                           hls::stream<UpdateReply> &UpdateResp,
+                           const ap_uint<8> weights[SOURCES],
+                           ap_uint<8> update_period,
+                           ap_uint<8> update_batch) {
+#pragma HLS pipeline II=1
+#pragma HLS inline all recursive
+#pragma HLS array_partition variable=LookupReq complete
+#pragma HLS array_partition variable=LookupResp complete
+#pragma HLS array_partition variable=weights complete
+
+    hls::algorithmic_cam<N, 4, KeyT, ValueT> &mycam = table();
+    const int SOURCEBITS = BitWidth<SOURCES>::Value;
+    static ap_uint<SOURCEBITS> current = 0; // The source currently being served.
+    static ap_uint<8> credit = 0; // Lookups remaining for the current source.
+    static ap_uint<8> waiting = 0; // Cycles that the head update has waited.
+    static ap_uint<8> batch = 0; // Updates remaining in the current batch.
+    static UpdateRequest update; // The update at the head of UpdateReq.
+    static bool update_valid = false;
+#pragma HLS reset variable=current
+#pragma HLS reset variable=credit
+#pragma HLS reset variable=waiting
+#pragma HLS reset variable=batch
+#pragma HLS reset variable=update_valid
+
+    ap_uint<SOURCES> pending;
+    for(int i = 0; i < SOURCES; i++) {
+#pragma HLS unroll
+        pending[i] = !LookupReq[i].empty();
+    }
+    // Hold the next update until the table can accept it.
+    if(!update_valid && !UpdateReq.empty()) {
+        update = UpdateReq.read();
+        update_valid = true;
+    }
+    bool update_ready = update_valid &&
+        (update.op ? mycam.canRemove() : mycam.canInsert());
+    bool do_update = update_ready &&
+        (batch != 0 || pending == 0 ||
+         (update_period != 0 && waiting >= update_period));
+
+    if(do_update) {
+        ap_uint<8> batch_size = update_batch == 0 ? ap_uint<8>(1) : update_batch;
+        batch = (batch == 0 ? batch_size : batch) - 1;
+        waiting = 0;
+        update_valid = false;
+        UpdateRequest req = update;
+        KeyT kin = req.key;
+        ValueT vin = req.value;
+        if(!req.op) {
+            bool b = mycam.insert(kin, vin);
+            assert("Cache is full" && b);
+        } else {
+            bool b = mycam.remove(kin);
+            assert(b);
+        }
+        UpdateReply resp(req.op);
+        resp.source = req.source;
+        UpdateResp.write(resp);
+    } else {
+        batch = 0;
+        if(!update_valid) {
+            waiting = 0;
+        } else if(waiting != ap_uint<8>(-1)) {
+            waiting++;
+        }
+        if(pending != 0) {
+            // Stay with the current source while it has credit, otherwise
+            // move to the next source with a pending lookup.
+            ap_uint<SOURCEBITS> s = current;
+            if(credit == 0 || !pending[current]) {
+                for(int i = SOURCES; i >= 1; i--) {
+#pragma HLS unroll
+                    ap_uint<SOURCEBITS+1> j = current + i;
+                    if(j >= SOURCES) j -= SOURCES;
+                    if(pending[j]) s = j;
+                }
+                credit = (weights[s] == 0) ? ap_uint<8>(1) : weights[s];
+                current = s;
+            }
+            credit--;
+            LookupRequest req = LookupReq[s].read();
+            KeyT k = req.key;
+            ValueT v;
+            bool b = mycam.get(k,v);
+            LookupReply resp(b,v);
+            resp.source = req.source;
+            LookupResp[s].write(resp);
+        }
+    }
+    // Migrate entries out of the cache concurrently with the request.
+    mycam.migrate();
+#ifdef DEBUG
+    std::cout << mycam << "\n";
+#endif
+}
+
+typedef cam_record<KeyT, ValueT> Record;
+
+// Load a stream of records, terminated by a record with last set,
+// directly into the table.  When the load completes, write the
+// number of records which could not be loaded to LoadResp.
+static void load(hls::stream<Record> &LoadReq,
+                 hls::stream<ap_uint<32> > &LoadResp) {
+    LoadResp.write(table().bulk_load(LoadReq));
+}
+
+// Write every entry in the table to DumpResp, setting last on the final
+// record.  When the dump completes, write the number of records to DumpCount.
+static void dump(hls::stream<Record> &DumpResp,
+                 hls::stream<ap_uint<32> > &DumpCount) {
+    DumpCount.write(table().dump(DumpResp));
+}
+
+// Remove every entry for which pred(key, value) returns true.
+// Return the number of entries removed.
+template <typename Pred>
+static int clear_if(Pred &pred) {
+    return table().clear_if(pred);
+}
+
+// Write a snapshot of the table to image.  See algorithmic_cam::save().
+// Return the number of words written.
+static int save(ap_uint<32> *image) {
+    return table().save(image);
+}
+
+// Restore the table from an image written by save().
+// Return true if the image was restored.
+static bool restore(const ap_uint<32> *image) {
+    return table().restore(image);
+}
+
 static void top(hls::stream<LookupRequest>	&LookupReq,
          hls::stream<LookupReply>		&LookupResp,
          hls::stream<UpdateRequest>	&UpdateReq,
@@ -961,53 +2288,11 @@ static void top(hls::stream<LookupRequest>	&LookupReq,
 	#pragma HLS DATA_PACK variable=LookupResp
 	#pragma HLS DATA_PACK variable=UpdateReq
 	#pragma HLS DATA_PACK variable=UpdateResp
-
-    static hls::algorithmic_cam<N, 4, KeyT, ValueT> mycam;
-
-    // get_loop: for(int i = 0; i < 16; i++) {
-#pragma HLS pipeline II=1
 #pragma HLS inline all recursive
 
-        if(!LookupReq.empty()) {
-            LookupRequest req = LookupReq.read();
-            KeyT k = req.key;
-            ValueT v;
-            bool b = mycam.get(k,v);
-            LookupReply resp(b,v);
-            resp.source = req.source;
-            LookupResp.write(resp);
-        } else
-        if(!UpdateReq.empty() && mycam.canInsert()) {
-            UpdateRequest req = UpdateReq.read();
-            KeyT kin = req.key;
-            ValueT vin = req.value;
-            if(!req.op) {
-                bool b = mycam.insert(kin, vin);
-                assert("Cache is full" && b);
-            } else {
-                mycam.remove(kin);
-            }
-            UpdateReply resp(req.op);
-            resp.source = req.source;
-            UpdateResp.write(resp);
-        }
-        else
-            mycam.sweep2();
-     //    else
-//             if(i%8) {
-// #pragma HLS occurrence cycle=8
-//             mycam.sweep();
-//         }
-//    }
-        std::cout << mycam << "\n"; 
-//  sweep_loop: for(int i = 0; i < 16; i++) {
-//         #pragma HLS pipeline II=1
-// // #pragma HLS dependence variable=mycam.mem_key false
-// // #pragma HLS dependence variable=mycam.mem_value false
-// // #pragma HLS dependence variable=mycam.mem_valid false
-
-//         mycam.sweep3();
-//  }
+    const ap_uint<8> weights[1] = {1};
+    arbitrated_top<1>(&LookupReq, &LookupResp, UpdateReq, UpdateResp,
+                      weights, DEFAULT_UPDATE_PERIOD, DEFAULT_UPDATE_BATCH);
 }
 
 };
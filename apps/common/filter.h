@@ -0,0 +1,230 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "cam.h"
+
+namespace hls {
+
+    // A set membership filter with no false negatives and a tunable
+    // false positive rate.  The BITS bits are split into K banks, each
+    // of which is indexed by an independent hash of the key, so that
+    // insert and contains each access every bank once and can run with II=1.
+    // BITS/K must be a power of 2.
+    template <int BITS, int K, typename KeyT>
+    class bloom_filter {
+    public:
+        const static int BANKSIZE = BITS/K;
+        const static int HASHBITS = BitWidth<BANKSIZE-1>::Value;
+        typedef ap_uint<HASHBITS> HashT;
+
+        bool bits[BANKSIZE][K];
+        h3_hash<KeyT, HASHBITS, K> hasher;
+
+        bloom_filter() {
+#pragma HLS array_partition variable=bits complete dim=2
+            clear();
+        }
+        void clear() {
+            for(int i = 0; i < BANKSIZE; i++) {
+#pragma HLS pipeline II=1
+                for(int j = 0; j < K; j++) {
+                    bits[i][j] = false;
+                }
+            }
+        }
+        // Add key to the set.
+        void insert(const KeyT &key) {
+#pragma HLS pipeline II=1
+            for(int j = 0; j < K; j++) {
+#pragma HLS unroll
+                bits[hasher.hash(key, j)][j] = true;
+            }
+        }
+        // Return true if key may be in the set, or false if it is definitely not.
+        bool contains(const KeyT &key) {
+#pragma HLS pipeline II=1
+            bool b = true;
+            for(int j = 0; j < K; j++) {
+#pragma HLS unroll
+                b = b && bits[hasher.hash(key, j)][j];
+            }
+            return b;
+        }
+        // Add key to the set.
+        // Return true if key may already have been in the set.
+        bool test_and_insert(const KeyT &key) {
+#pragma HLS pipeline II=1
+            bool b = true;
+            for(int j = 0; j < K; j++) {
+#pragma HLS unroll
+                HashT hash = hasher.hash(key, j);
+                b = b && bits[hash][j];
+                bits[hash][j] = true;
+            }
+            return b;
+        }
+    };
+
+    // A set membership filter which stores a FPBITS-bit fingerprint of each
+    // key, and which supports removal.  Each key has two candidate buckets of
+    // WAYS fingerprints, where the second bucket is computed from the first
+    // bucket and the fingerprint (i.e. partial-key cuckoo hashing).
+    // BUCKETS and WAYS must be powers of 2.
+    // Like algorithmic_cam, insert() never moves existing entries.  If both
+    // buckets are full, then a fingerprint is displaced into a victim register
+    // and sweep() moves it to its alternate bucket in the background, one
+    // displacement per call.
+    template <int BUCKETS, int WAYS, int FPBITS, typename KeyT>
+    class cuckoo_filter {
+    public:
+        const static int BUCKETBITS = BitWidth<BUCKETS-1>::Value;
+        typedef ap_uint<BUCKETBITS> BucketT;
+        // A fingerprint of zero marks an empty slot.
+        typedef ap_uint<FPBITS> FingerprintT;
+
+        FingerprintT table[BUCKETS][WAYS];
+        h3_hash<KeyT, BUCKETBITS, 1> bucket_hasher;
+        h3_hash<KeyT, FPBITS, 1> fingerprint_hasher;
+        h3_hash<FingerprintT, BUCKETBITS, 1> alternate_hasher;
+        // A fingerprint which has been displaced from its bucket.
+        FingerprintT victim;
+        BucketT victim_bucket;
+        bool victim_valid;
+        ap_uint<BitWidth<WAYS-1>::Value> kick_way;
+
+        cuckoo_filter() {
+#pragma HLS array_partition variable=table complete dim=2
+            clear();
+        }
+        void clear() {
+            for(int i = 0; i < BUCKETS; i++) {
+#pragma HLS pipeline II=1
+                for(int j = 0; j < WAYS; j++) {
+                    table[i][j] = 0;
+                }
+            }
+            victim_valid = false;
+            kick_way = 0;
+        }
+        FingerprintT fingerprint(const KeyT &key) {
+            FingerprintT fp = fingerprint_hasher.hash(key, 0);
+            return (fp == 0) ? FingerprintT(1) : fp;
+        }
+        BucketT alternate(const BucketT &bucket, const FingerprintT &fp) {
+            return bucket ^ alternate_hasher.hash(fp, 0);
+        }
+        // Return a mask of the ways in bucket which hold fp.
+        ap_uint<WAYS> match(const BucketT &bucket, const FingerprintT &fp) {
+            ap_uint<WAYS> m;
+            for(int j = 0; j < WAYS; j++) {
+#pragma HLS unroll
+                m[j] = table[bucket][j] == fp;
+            }
+            return m;
+        }
+        // Return the lowest free way in bucket, or -1 if the bucket is full.
+        int free_way(const BucketT &bucket) {
+            int way = -1;
+            for(int j = WAYS-1; j >= 0; j--) {
+#pragma HLS unroll
+                if(table[bucket][j] == 0) way = j;
+            }
+            return way;
+        }
+        bool canInsert() {
+            return !victim_valid;
+        }
+        // Add key to the set.
+        // Return true if the operation succeeds or false if it should be retried.
+        bool insert(const KeyT &key) {
+#pragma HLS pipeline II=1
+            if(victim_valid) return false;
+            FingerprintT fp = fingerprint(key);
+            BucketT b1 = bucket_hasher.hash(key, 0);
+            BucketT b2 = alternate(b1, fp);
+            int w1 = free_way(b1);
+            int w2 = free_way(b2);
+            if(w1 >= 0) {
+                table[b1][w1] = fp;
+            } else if(w2 >= 0) {
+                table[b2][w2] = fp;
+            } else {
+                // Both buckets are full, so displace a fingerprint.
+                victim = table[b1][kick_way];
+                victim_bucket = b1;
+                victim_valid = true;
+                table[b1][kick_way] = fp;
+                kick_way++;
+            }
+            return true;
+        }
+        // Return true if key may be in the set, or false if it is definitely not.
+        bool contains(const KeyT &key) {
+#pragma HLS pipeline II=1
+            FingerprintT fp = fingerprint(key);
+            BucketT b1 = bucket_hasher.hash(key, 0);
+            BucketT b2 = alternate(b1, fp);
+            bool v = victim_valid && victim == fp &&
+                (victim_bucket == b1 || victim_bucket == b2);
+            return match(b1, fp) != 0 || match(b2, fp) != 0 || v;
+        }
+        // Remove one copy of key from the set.  Only keys which were
+        // previously inserted should be removed.
+        // Return true if the key was found.
+        bool remove(const KeyT &key) {
+#pragma HLS pipeline II=1
+            FingerprintT fp = fingerprint(key);
+            BucketT b1 = bucket_hasher.hash(key, 0);
+            BucketT b2 = alternate(b1, fp);
+            ap_uint<WAYS> m1 = match(b1, fp);
+            ap_uint<WAYS> m2 = match(b2, fp);
+            if(victim_valid && victim == fp &&
+               (victim_bucket == b1 || victim_bucket == b2)) {
+                victim_valid = false;
+            } else if(m1 != 0) {
+                table[b1][m1.reverse().countLeadingZeros()] = 0;
+            } else if(m2 != 0) {
+                table[b2][m2.reverse().countLeadingZeros()] = 0;
+            } else {
+                return false;
+            }
+            return true;
+        }
+        // Move the victim, if any, to its alternate bucket, displacing
+        // another fingerprint if that bucket is also full.
+        // Return true if there is still a victim to be placed.
+        bool sweep() {
+#pragma HLS pipeline II=1
+            if(!victim_valid) return false;
+            BucketT b = alternate(victim_bucket, victim);
+            int w = free_way(b);
+            if(w >= 0) {
+                table[b][w] = victim;
+                victim_valid = false;
+            } else {
+                FingerprintT fp = table[b][kick_way];
+                table[b][kick_way] = victim;
+                victim = fp;
+                victim_bucket = b;
+                kick_way++;
+            }
+            return victim_valid;
+        }
+    };
+}
@@ -0,0 +1,219 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "cam.h"
+#include "allocator.h"
+
+namespace hls {
+
+    // The flow key used by flow_table: the IPv4 5-tuple.
+    typedef ap_uint<104> five_tuple;
+
+    inline five_tuple make_five_tuple(ap_uint<32> srcIP, ap_uint<32> dstIP,
+                                      ap_uint<16> srcPort, ap_uint<16> dstPort,
+                                      ap_uint<8> protocol) {
+        five_tuple key;
+        key(103, 72) = srcIP;
+        key(71, 40) = dstIP;
+        key(39, 24) = srcPort;
+        key(23, 8) = dstPort;
+        key(7, 0) = protocol;
+        return key;
+    }
+
+    // Per-flow state kept by flow_table.
+    template <typename CounterT, typename TimeT>
+    struct flow_stats {
+        CounterT packets;
+        CounterT bytes;
+        TimeT first_seen;
+        TimeT last_seen;
+    };
+
+    // A flow exported by flow_table.
+    template <typename KeyT, typename CounterT, typename TimeT>
+    struct flow_record {
+        KeyT key;
+        CounterT packets;
+        CounterT bytes;
+        TimeT first_seen;
+        TimeT last_seen;
+        flow_record() {}
+        flow_record(const KeyT &k, const flow_stats<CounterT, TimeT> &s) :
+            key(k), packets(s.packets), bytes(s.bytes),
+            first_seen(s.first_seen), last_seen(s.last_seen) {}
+    };
+
+    // Exact-match flow accounting.  Each flow is identified by a key
+    // (typically a five_tuple) which is mapped by an algorithmic_cam to a
+    // flow id, which indexes the per-flow counters and timestamps.
+    // update() accounts for one packet per call with II=1.  The counters of
+    // the last FORWARD flows updated are forwarded, so that packets of the
+    // same flow a few cycles apart do not stall.  expire() is intended to be
+    // called once per cycle alongside update().  It visits one flow per call
+    // and exports flows which have been idle, or active, for longer than the
+    // configured timeouts.
+    // New flows are added to the cache of the algorithmic_cam, so only a few
+    // new flows can be added back-to-back before they are migrated.  Packets
+    // which cannot be accounted for are counted in 'untracked'.
+    // SIZE is power of 2, FACTOR is power of 2.  At most SIZE-1 flows are tracked.
+    template <int SIZE, int FACTOR, typename KeyT = five_tuple,
+              typename CounterT = ap_uint<64>, typename TimeT = ap_uint<32> >
+    class flow_table {
+    public:
+        typedef ap_uint<BitWidth<SIZE-1>::Value> IdT;
+        typedef flow_stats<CounterT, TimeT> StatsT;
+        typedef flow_record<KeyT, CounterT, TimeT> RecordT;
+
+        algorithmic_cam<SIZE, FACTOR, KeyT, IdT> flows;
+        Allocator<SIZE> ids;
+        KeyT keys[SIZE];
+        StatsT stats[SIZE];
+        // The last FORWARD flows updated, newest first, so that packets of
+        // the same flow a few cycles apart can be pipelined while the
+        // previous write is still in flight.
+        const static int FORWARD = 2;
+        IdT last_id[FORWARD];
+        StatsT last_stats[FORWARD];
+        bool last_valid[FORWARD];
+        // Expiry configuration.  A timeout of zero is disabled.
+        TimeT idle_timeout;
+        TimeT active_timeout;
+        IdT expire_id;
+        CounterT untracked;
+
+        flow_table() {
+#pragma HLS data_pack variable=stats
+#pragma HLS array_partition variable=last_id complete
+#pragma HLS array_partition variable=last_stats complete
+#pragma HLS array_partition variable=last_valid complete
+            idle_timeout = 0;
+            active_timeout = 0;
+            clear();
+        }
+        void clear() {
+            flows.clear();
+            ids.clear();
+            for(int d = 0; d < FORWARD; d++) {
+                last_valid[d] = false;
+            }
+            expire_id = 0;
+            untracked = 0;
+        }
+        // Export flows which have not seen a packet for idle time units, or
+        // which were first seen more than active time units ago.
+        void set_timeouts(const TimeT &idle, const TimeT &active) {
+            idle_timeout = idle;
+            active_timeout = active;
+        }
+        StatsT read_stats(const IdT &id) {
+            StatsT s = stats[id];
+            for(int d = FORWARD-1; d >= 0; d--) {
+#pragma HLS unroll
+                if(last_valid[d] && last_id[d] == id) s = last_stats[d];
+            }
+            return s;
+        }
+        void write_stats(const IdT &id, const StatsT &s) {
+            stats[id] = s;
+            for(int d = FORWARD-1; d > 0; d--) {
+#pragma HLS unroll
+                last_id[d] = last_id[d-1];
+                last_stats[d] = last_stats[d-1];
+                last_valid[d] = last_valid[d-1];
+            }
+            last_id[0] = id;
+            last_stats[0] = s;
+            last_valid[0] = true;
+        }
+        // Return true if key is the subject of a pending remove, in which
+        // case the algorithmic_cam must not be updated with key.
+        bool expiring(const KeyT &key) {
+            return !flows.canRemove() && flows.deleted_key == key;
+        }
+        // Account for a packet of the given length in the flow identified by key
+        // at time now, creating the flow if necessary.
+        // Return true if the packet was accounted for.
+        bool update(const KeyT &key, const ap_uint<16> &length, const TimeT &now) {
+#pragma HLS pipeline II=1
+#pragma HLS dependence variable=stats inter false
+            if(expiring(key)) {
+                untracked++;
+                return false;
+            }
+            IdT id;
+            StatsT s;
+            if(flows.get(key, id)) {
+                s = read_stats(id);
+                s.packets++;
+                s.bytes += length;
+                s.last_seen = now;
+            } else {
+                int n = flows.canInsert() ? ids.allocate() : -1;
+                if(n < 0) {
+                    untracked++;
+                    return false;
+                }
+                id = n;
+                flows.insert(key, id);
+                keys[id] = key;
+                s.packets = 1;
+                s.bytes = length;
+                s.first_seen = now;
+                s.last_seen = now;
+            }
+            write_stats(id, s);
+            return true;
+        }
+        // Return true if key is a current flow.
+        // In addition, return the state of the flow.
+        bool get(const KeyT &key, RecordT &record) {
+            IdT id;
+            if(expiring(key) || !flows.get(key, id)) return false;
+            record = RecordT(key, read_stats(id));
+            return true;
+        }
+        // Migrate new flows into the algorithmic_cam and visit the next flow
+        // id, exporting the flow to out if it has timed out at time now.
+        // Return true if a flow was exported.
+        bool expire(const TimeT &now, hls::stream<RecordT> &out) {
+#pragma HLS pipeline II=1
+            flows.migrate();
+            IdT id = expire_id;
+            if(!flows.canRemove()) return false;
+            expire_id++;
+            if(!ids.is_allocated(id)) return false;
+            StatsT s = read_stats(id);
+            bool idle = idle_timeout != 0 && TimeT(now - s.last_seen) >= idle_timeout;
+            bool active = active_timeout != 0 && TimeT(now - s.first_seen) >= active_timeout;
+            if(!idle && !active) return false;
+            out.write(RecordT(keys[id], s));
+            flows.remove(keys[id]);
+            ids.deallocate(id);
+            for(int d = 0; d < FORWARD; d++) {
+#pragma HLS unroll
+                if(last_id[d] == id) last_valid[d] = false;
+            }
+#ifdef DEBUG
+            std::cout << "Expire " << keys[id] << " " << s.packets << " packets\n";
+#endif
+            return true;
+        }
+    };
+}
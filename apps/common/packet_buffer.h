@@ -0,0 +1,304 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "ap_axi_sdata.h"
+#include "hls_stream.h"
+#include "allocator.h"
+
+namespace hls {
+
+    // A reference to a packet stored in a packet buffer, which is passed
+    // between pipeline stages instead of the packet itself.
+    struct packet_descriptor {
+        ap_uint<16> id;
+        ap_uint<16> length;
+        packet_descriptor() {}
+        packet_descriptor(ap_uint<16> i, ap_uint<16> l) : id(i), length(l) {}
+    };
+
+    // Return the number of bytes kept in a beat with the given keep flags.
+    template <int BYTES>
+    int kept_bytes(ap_uint<BYTES> keep) {
+        int count = 0;
+        for(int i = 0; i < BYTES; i++) {
+#pragma HLS unroll
+            count += keep[i];
+        }
+        return count;
+    }
+
+    // A pool of BUFFERS-1 packet buffers, each of up to MAXLENGTH bytes,
+    // stored in a memory of BYTES-byte words provided by the caller (either
+    // an on-chip array or a pointer to external memory).  store() copies a
+    // packet from a stream into a free buffer and produces a descriptor,
+    // and load() copies the packet described by a descriptor back to a
+    // stream, so that stages in between only pass descriptors.  Each
+    // buffer has a reference count, so a packet can be loaded several times
+    // (e.g. for multicast) by calling retain() before it is loaded.  The
+    // buffer is freed when the last reference is loaded or released.
+    // The keep flags of each beat are kept on chip and the packet is
+    // replayed beat for beat, so beats before the last need not be full.
+    template <int BYTES, int BUFFERS, int MAXLENGTH>
+    class packet_buffer_pool {
+    public:
+        typedef ap_axiu<8*BYTES, 1, 1, 1> BeatT;
+        typedef ap_uint<8*BYTES> WordT;
+        typedef ap_uint<BYTES> KeepT;
+        const static int BUFFERBEATS = (MAXLENGTH + BYTES - 1)/BYTES;
+        const static int WORDS = (BUFFERS-1)*BUFFERBEATS;
+
+        Allocator<BUFFERS> allocator;
+        ap_uint<8> refcount[BUFFERS];
+        // The number of beats in each packet.
+        ap_uint<BitWidth<BUFFERBEATS>::Value> beat_count[BUFFERS];
+        // The keep flags of each beat stored in memory.
+        KeepT beat_keep[WORDS];
+        // Packets dropped because no buffer was free or they were too long.
+        ap_uint<32> dropped;
+
+        packet_buffer_pool() {
+            dropped = 0;
+        }
+        void clear() {
+            allocator.clear();
+            dropped = 0;
+        }
+        // Return the offset in memory of the start of buffer id.
+        static int base(int id) {
+            return (id-1)*BUFFERBEATS;
+        }
+        int size() {
+            return allocator.size();
+        }
+        // Copy one packet from in to a free buffer in memory, and write its
+        // descriptor to out.  If no buffer is free, or the packet is longer
+        // than MAXLENGTH or has more than BUFFERBEATS beats, then the packet
+        // is dropped.
+        // Return true if the packet was stored.
+        bool store(hls::stream<BeatT> &in, hls::stream<packet_descriptor> &out, WordT memory[WORDS]) {
+            int id = allocator.allocate();
+            int length = 0;
+            int i = 0;
+            BeatT t;
+        store_loop:
+            do {
+#pragma HLS pipeline II=1
+                t = in.read();
+                if(id >= 0 && i < BUFFERBEATS) {
+                    memory[base(id) + i] = t.data;
+                    beat_keep[base(id) + i] = t.keep;
+                }
+                length += kept_bytes<BYTES>(t.keep);
+                i++;
+            } while(!t.last);
+            if(id >= 0 && (length > MAXLENGTH || i > BUFFERBEATS)) {
+                allocator.deallocate(id);
+                id = -1;
+            }
+            if(id < 0) {
+                dropped++;
+                return false;
+            }
+            refcount[id] = 1;
+            beat_count[id] = i;
+            out.write(packet_descriptor(id, length));
+            return true;
+        }
+        // Add count references to the packet described by d.
+        void retain(const packet_descriptor &d, int count) {
+            refcount[d.id] += count;
+        }
+        // Remove a reference to the packet described by d, freeing its buffer
+        // if it was the last reference.
+        void release(const packet_descriptor &d) {
+            ap_uint<8> r = refcount[d.id] - 1;
+            refcount[d.id] = r;
+            if(r == 0) allocator.deallocate(d.id);
+        }
+        // Copy the packet described by d from memory to out, and release it.
+        void load(const packet_descriptor &d, hls::stream<BeatT> &out, WordT memory[WORDS]) {
+            int beats = beat_count[d.id];
+        load_loop:
+            for(int i = 0; i < beats; i++) {
+#pragma HLS pipeline II=1
+                BeatT t;
+                t.data = memory[base(d.id) + i];
+                t.keep = beat_keep[base(d.id) + i];
+                t.strb = t.keep;
+                t.last = i == beats-1;
+                out.write(t);
+            }
+            release(d);
+        }
+        // Read a descriptor from in and load the packet it describes.
+        void load(hls::stream<packet_descriptor> &in, hls::stream<BeatT> &out, WordT memory[WORDS]) {
+            load(in.read(), out, memory);
+        }
+    };
+
+    // A packet buffer where each packet is stored in a chain of cells of
+    // CELLBYTES bytes, so that the number of packets which can be stored
+    // depends on their actual length rather than the maximum length.  The
+    // cells are allocated from a free list as a packet is stored, and the
+    // cells of a packet are linked through a next-cell table, which store()
+    // and load() follow at II=1.  A descriptor identifies the first cell of
+    // the packet.  As with packet_buffer_pool, the cell memory is provided by
+    // the caller and packets are reference counted, and the keep flags of
+    // each beat are kept on chip so that packets are replayed beat for beat.
+    // At most CELLS-1 cells are used.  CELLBYTES must be a multiple of BYTES.
+    template <int BYTES, int CELLS, int CELLBYTES>
+    class chained_packet_buffer {
+    public:
+        typedef ap_axiu<8*BYTES, 1, 1, 1> BeatT;
+        typedef ap_uint<8*BYTES> WordT;
+        typedef ap_uint<BitWidth<CELLS>::Value> CellT;
+        typedef ap_uint<BYTES> KeepT;
+        const static int CELLBEATS = CELLBYTES/BYTES;
+        const static int WORDS = (CELLS-1)*CELLBEATS;
+
+        Allocator<CELLS> allocator;
+        CellT next_cell[CELLS];
+        // The reference count of each packet, indexed by its first cell.
+        ap_uint<8> refcount[CELLS];
+        // The number of beats in each packet, indexed by its first cell.
+        ap_uint<BitWidth<WORDS>::Value> beat_count[CELLS];
+        // The keep flags of each beat stored in memory.
+        KeepT beat_keep[WORDS];
+        // Packets dropped because there were not enough free cells.
+        ap_uint<32> dropped;
+
+        chained_packet_buffer() {
+            dropped = 0;
+        }
+        void clear() {
+            allocator.clear();
+            dropped = 0;
+        }
+        // Return the offset in memory of the start of the given cell.
+        static int base(int cell) {
+            return (cell-1)*CELLBEATS;
+        }
+        // Return the number of cells in use.
+        int size() {
+            return allocator.size();
+        }
+        // Free a chain of the given number of cells starting at cell.
+        void free_chain(int cell, int cells) {
+        free_loop:
+            for(int i = 0; i < cells; i++) {
+#pragma HLS pipeline II=1
+                int next = next_cell[cell];
+                allocator.deallocate(cell);
+                cell = next;
+            }
+        }
+        // Copy one packet from in to a chain of free cells in memory, and
+        // write its descriptor to out.  If there are not enough free cells,
+        // then the packet is dropped.
+        // Return true if the packet was stored.
+        bool store(hls::stream<BeatT> &in, hls::stream<packet_descriptor> &out, WordT memory[WORDS]) {
+            int head = -1;
+            int cell = -1;
+            int cells = 0;
+            bool failed = false;
+            int length = 0;
+            int beats = 0;
+            int offset = CELLBEATS;
+            BeatT t;
+        store_loop:
+            do {
+#pragma HLS pipeline II=1
+                t = in.read();
+                if(offset == CELLBEATS && !failed) {
+                    // Move on to a new cell.
+                    int c = allocator.allocate();
+                    if(c < 0) {
+                        failed = true;
+                    } else {
+                        if(cell >= 0) next_cell[cell] = c;
+                        else head = c;
+                        cell = c;
+                        cells++;
+                        offset = 0;
+                    }
+                }
+                if(!failed) {
+                    memory[base(cell) + offset] = t.data;
+                    beat_keep[base(cell) + offset] = t.keep;
+                    offset++;
+                    beats++;
+                }
+                length += kept_bytes<BYTES>(t.keep);
+            } while(!t.last);
+            if(failed) {
+                if(head >= 0) free_chain(head, cells);
+                dropped++;
+                return false;
+            }
+            refcount[head] = 1;
+            beat_count[head] = beats;
+            out.write(packet_descriptor(head, length));
+            return true;
+        }
+        // Add count references to the packet described by d.
+        void retain(const packet_descriptor &d, int count) {
+            refcount[d.id] += count;
+        }
+        // Remove a reference to the packet described by d, freeing its cells
+        // if it was the last reference.
+        void release(const packet_descriptor &d) {
+            ap_uint<8> r = refcount[d.id] - 1;
+            refcount[d.id] = r;
+            if(r == 0) free_chain(d.id, (beat_count[d.id] + CELLBEATS - 1)/CELLBEATS);
+        }
+        // Copy the packet described by d from memory to out, and release it.
+        // If this is the last reference, then each cell is freed once it has been read.
+        void load(const packet_descriptor &d, hls::stream<BeatT> &out, WordT memory[WORDS]) {
+            ap_uint<8> r = refcount[d.id] - 1;
+            refcount[d.id] = r;
+            bool last_reference = r == 0;
+            int beats = beat_count[d.id];
+            int cell = d.id;
+            int offset = 0;
+        load_loop:
+            for(int i = 0; i < beats; i++) {
+#pragma HLS pipeline II=1
+                BeatT t;
+                t.data = memory[base(cell) + offset];
+                t.keep = beat_keep[base(cell) + offset];
+                bool last = i == beats-1;
+                t.strb = t.keep;
+                t.last = last;
+                out.write(t);
+                offset++;
+                if(offset == CELLBEATS || last) {
+                    // Follow the chain to the next cell.
+                    int next = next_cell[cell];
+                    if(last_reference) allocator.deallocate(cell);
+                    cell = next;
+                    offset = 0;
+                }
+            }
+        }
+        // Read a descriptor from in and load the packet it describes.
+        void load(hls::stream<packet_descriptor> &in, hls::stream<BeatT> &out, WordT memory[WORDS]) {
+            load(in.read(), out, memory);
+        }
+    };
+}
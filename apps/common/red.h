@@ -0,0 +1,122 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "ap_int.h"
+
+namespace hls {
+
+    // A 32-bit linear feedback shift register (in Galois form), which
+    // produces a new 16-bit pseudo-random value in each call.  The register
+    // is advanced 16 steps per call so that successive values are not
+    // simply shifted copies of each other.
+    class lfsr {
+    public:
+        ap_uint<32> state;
+        lfsr() : state(0xACE1ACE1) {}
+        void seed(const ap_uint<32> &s) {
+            state = (s == 0) ? ap_uint<32>(0xACE1ACE1) : s;
+        }
+        ap_uint<16> next() {
+#pragma HLS inline
+            for(int i = 0; i < 16; i++) {
+#pragma HLS unroll
+                bool lsb = state[0];
+                state >>= 1;
+                if(lsb) state ^= 0x80200003;
+            }
+            return state(15, 0);
+        }
+    };
+
+    // Random early detection for N queues, with a separate drop curve for
+    // each queue (i.e. weighted RED).  The average depth of each queue is
+    // an exponentially weighted moving average of its depth when packets
+    // arrive, where each new sample has a weight of 2^-weight.  Below
+    // min_threshold no packets are dropped, and above max_threshold every
+    // packet is dropped.  In between, packets are dropped with a probability
+    // rising linearly to max_probability/2^16 at max_threshold.  A
+    // max_threshold of zero disables RED for the queue.
+    template <int N, int FRACBITS = 8>
+    class red {
+    public:
+        typedef ap_uint<32> DepthT;
+        typedef ap_uint<16> ProbabilityT;
+        typedef ap_uint<32+FRACBITS> AverageT;
+
+        DepthT min_threshold[N];
+        DepthT max_threshold[N];
+        ProbabilityT max_probability[N];
+        AverageT average[N];
+        ap_uint<5> weight;
+        lfsr random;
+
+        red() {
+#pragma HLS array_partition variable=min_threshold complete
+#pragma HLS array_partition variable=max_threshold complete
+#pragma HLS array_partition variable=max_probability complete
+#pragma HLS array_partition variable=average complete
+            weight = 9;
+            for(int i = 0; i < N; i++) {
+                min_threshold[i] = 0;
+                max_threshold[i] = 0;
+                max_probability[i] = 0;
+            }
+            clear();
+        }
+        void clear() {
+            for(int i = 0; i < N; i++) {
+#pragma HLS unroll
+                average[i] = 0;
+            }
+        }
+        void set_weight(int w) {
+            weight = w;
+        }
+        void set_min_threshold(int q, const DepthT &depth) {
+            min_threshold[q] = depth;
+        }
+        void set_max_threshold(int q, const DepthT &depth) {
+            max_threshold[q] = depth;
+        }
+        void set_max_probability(int q, const ProbabilityT &p) {
+            max_probability[q] = p;
+        }
+        // Return the average depth of queue q, without fractional bits.
+        DepthT average_depth(int q) {
+            return average[q] >> FRACBITS;
+        }
+        // Update the average depth of queue q with its depth when a packet arrives.
+        // Return true if the packet should be dropped (or marked).
+        bool congested(int q, const DepthT &depth) {
+#pragma HLS inline
+            ap_int<34+FRACBITS> diff = ap_int<34+FRACBITS>(AverageT(depth) << FRACBITS) - average[q];
+            AverageT a = average[q] + (diff >> weight);
+            average[q] = a;
+            DepthT avg = a >> FRACBITS;
+            ap_uint<16> r = random.next();
+            if(max_threshold[q] == 0 || avg < min_threshold[q]) return false;
+            if(avg >= max_threshold[q]) return true;
+            // Compare r/2^16 < max_probability/2^16 * (avg - min)/(max - min),
+            // without dividing.
+            ap_uint<48> lhs = r * (max_threshold[q] - min_threshold[q]);
+            ap_uint<48> rhs = max_probability[q] * (avg - min_threshold[q]);
+            return lhs < rhs;
+        }
+    };
+}
@@ -0,0 +1,210 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "ap_int.h"
+#include "hls/utils/x_hls_utils.h"
+
+namespace hls {
+
+    enum scheduler_mode {
+        // Always send from the highest numbered nonempty queue.
+        STRICT_PRIORITY,
+        // Visit the nonempty queues in turn, sending up to quantum bytes
+        // from each queue per visit.
+        DEFICIT_ROUND_ROBIN,
+        // Send the packet with the smallest virtual finish time, where each
+        // byte of a packet costs cost virtual time units.
+        WEIGHTED_FAIR_QUEUEING
+    };
+
+    // Choose which of N queues to send a packet from, given which queues
+    // are nonempty and the length of the packet at the head of each queue.
+    // The mode can be changed at any time.  Each queue has a quantum in
+    // bytes, which sets its share of bandwidth for DEFICIT_ROUND_ROBIN,
+    // and a cost per byte, which is inversely proportional to its share of
+    // bandwidth for WEIGHTED_FAIR_QUEUEING.  Quanta should be at least the
+    // largest packet length, so that every visit sends at least one packet.
+    // WEIGHTED_FAIR_QUEUEING is approximated by computing the finish time of
+    // a packet when it reaches the head of its queue, using the finish time
+    // of the last packet sent as the virtual time (i.e. self-clocked fair
+    // queueing).
+    template <int N, typename LengthT = ap_uint<16> >
+    class scheduler {
+    public:
+        typedef ap_uint<32> QuantumT;
+        typedef ap_uint<16> CostT;
+        typedef ap_uint<32> TimeT;
+
+        scheduler_mode mode;
+        QuantumT quantum[N];
+        QuantumT deficit[N];
+        ap_uint<BitWidth<N-1>::Value> current;
+        CostT cost[N];
+        TimeT finish[N]; // The finish time of the last packet started from each queue.
+        TimeT tag[N]; // The finish time of the packet at the head of each queue.
+        bool tag_valid[N];
+        TimeT virtual_time;
+
+        scheduler() {
+#pragma HLS array_partition variable=quantum complete
+#pragma HLS array_partition variable=deficit complete
+#pragma HLS array_partition variable=cost complete
+#pragma HLS array_partition variable=finish complete
+#pragma HLS array_partition variable=tag complete
+#pragma HLS array_partition variable=tag_valid complete
+            mode = STRICT_PRIORITY;
+            for(int i = 0; i < N; i++) {
+                quantum[i] = 2048;
+                cost[i] = 1;
+            }
+            clear();
+        }
+        void clear() {
+            for(int i = 0; i < N; i++) {
+#pragma HLS unroll
+                deficit[i] = 0;
+                finish[i] = 0;
+                tag_valid[i] = false;
+            }
+            current = 0;
+            virtual_time = 0;
+        }
+        void set_mode(scheduler_mode m) {
+            mode = m;
+            clear();
+        }
+        void set_quantum(int q, const QuantumT &bytes) {
+            quantum[q] = bytes;
+        }
+        void set_cost(int q, const CostT &c) {
+            cost[q] = c;
+        }
+        // Choose the queue to send from.  If ready is false, then nothing
+        // will be sent and the state of the scheduler is not changed.
+        // Return the queue, or -1 if no packet should be sent.
+        int schedule(const bool nonempty[N], const LengthT length[N], bool ready) {
+#pragma HLS inline
+            return schedule(nonempty, nonempty, length, ready);
+        }
+        // As above, but only send from queues which are eligible, for
+        // instance because they are within their shaping rate.  Queues
+        // which are nonempty but not eligible keep their place.
+        int schedule(const bool nonempty[N], const bool eligible[N], const LengthT length[N], bool ready) {
+#pragma HLS inline
+            // The highest nonempty queue.
+            int highest = -1;
+            // The next nonempty queue after current, in round robin order.
+            int next = -1;
+            for(int i = 0; i < N; i++) {
+#pragma HLS unroll
+                if(eligible[i]) highest = i;
+            }
+            for(int k = N; k > 0; k--) {
+#pragma HLS unroll
+                int i = (current + k) % N;
+                if(eligible[i]) next = i;
+            }
+
+            // Compute the finish time of the packet at the head of each
+            // queue and find the earliest.  Times are compared relative to
+            // virtual_time, so that they can wrap.
+            TimeT t[N];
+            int earliest = -1;
+            TimeT earliest_delay = TimeT(-1);
+            for(int i = 0; i < N; i++) {
+#pragma HLS unroll
+                TimeT start = (ap_int<32>(finish[i] - virtual_time) > 0) ? finish[i] : virtual_time;
+                t[i] = tag_valid[i] ? tag[i] : TimeT(start + length[i]*cost[i]);
+                TimeT delay = t[i] - virtual_time;
+                if(eligible[i] && delay < earliest_delay) {
+                    earliest_delay = delay;
+                    earliest = i;
+                }
+            }
+
+            int q = -1;
+            if(mode == STRICT_PRIORITY) {
+                q = highest;
+            } else if(mode == DEFICIT_ROUND_ROBIN) {
+                if(eligible[current] && length[current] <= deficit[current]) {
+                    q = current;
+                } else if(next >= 0) {
+                    // Visit the next queue.
+                    QuantumT d = deficit[next] + quantum[next];
+                    if(ready) {
+                        deficit[next] = d;
+                        current = next;
+                    }
+                    if(length[next] <= d) q = next;
+                }
+            } else {
+                q = earliest;
+            }
+            if(!ready) return -1;
+
+            for(int i = 0; i < N; i++) {
+#pragma HLS unroll
+                // A queue which empties loses its deficit.
+                if(!nonempty[i]) deficit[i] = 0;
+                if(i == q && mode == DEFICIT_ROUND_ROBIN) deficit[i] -= length[i];
+                // Remember the finish time of each head packet, so that it
+                // does not change as virtual_time advances.
+                tag[i] = t[i];
+                tag_valid[i] = nonempty[i] && i != q;
+            }
+            if(q >= 0) {
+                finish[q] = t[q];
+                virtual_time = t[q];
+            }
+            return q;
+        }
+        // Record that the packet at the head of queue q was removed without
+        // being sent.
+        void drop(int q) {
+            tag_valid[q] = false;
+        }
+        // Choose a queue to drop a packet from, given the number of bytes
+        // in each queue.  For STRICT_PRIORITY this is the lowest nonempty
+        // queue, otherwise this is the queue with the most bytes, so that
+        // queues receiving more than their share lose packets first.
+        // If arriving is the queue of a packet waiting to be enqueued, then
+        // for STRICT_PRIORITY a lower arriving queue is dropped instead.
+        // Return the queue, or -1 if all the queues are empty or the
+        // arriving packet should be dropped.
+        template <typename BytesT>
+        int victim(const bool nonempty[N], const BytesT bytes[N], int arriving = -1) {
+#pragma HLS inline
+            int lowest = -1;
+            int longest = -1;
+            BytesT longest_bytes = 0;
+            for(int i = N-1; i >= 0; i--) {
+#pragma HLS unroll
+                if(nonempty[i]) lowest = i;
+                if(nonempty[i] && bytes[i] >= longest_bytes) {
+                    longest_bytes = bytes[i];
+                    longest = i;
+                }
+            }
+            if(mode == STRICT_PRIORITY) {
+                return (arriving >= 0 && arriving < lowest) ? -1 : lowest;
+            }
+            return longest;
+        }
+    };
+}
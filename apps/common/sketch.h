@@ -0,0 +1,188 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "cam.h"
+
+namespace hls {
+
+    // An approximate per-key counter which uses a fixed amount of memory
+    // regardless of the number of keys.  Each of the ROWS rows holds COLS
+    // counters, indexed by an independent hash of the key.  The estimate for
+    // a key is the minimum of its counters, which is never less than the true
+    // count.  Counters saturate rather than wrapping.  COLS must be a power of 2.
+    template <int ROWS, int COLS, typename CounterT, typename KeyT>
+    class count_min_sketch {
+    public:
+        const static int HASHBITS = BitWidth<COLS-1>::Value;
+        typedef ap_uint<HASHBITS> HashT;
+
+        CounterT counters[COLS][ROWS];
+        h3_hash<KeyT, HASHBITS, ROWS> hasher;
+        // The last FORWARD counters written in each row, newest first, so
+        // that updates of the same counter a few cycles apart can be
+        // pipelined while the previous write is still in flight.
+        const static int FORWARD = 2;
+        HashT last_hash[FORWARD][ROWS];
+        CounterT last_count[FORWARD][ROWS];
+        bool last_valid[FORWARD][ROWS];
+
+        count_min_sketch() {
+#pragma HLS array_partition variable=counters complete dim=2
+#pragma HLS array_partition variable=last_hash complete dim=0
+#pragma HLS array_partition variable=last_count complete dim=0
+#pragma HLS array_partition variable=last_valid complete dim=0
+            clear();
+        }
+        void clear() {
+            for(int i = 0; i < COLS; i++) {
+#pragma HLS pipeline II=1
+                for(int j = 0; j < ROWS; j++) {
+                    counters[i][j] = 0;
+                }
+            }
+            for(int d = 0; d < FORWARD; d++) {
+                for(int j = 0; j < ROWS; j++) {
+                    last_valid[d][j] = false;
+                }
+            }
+        }
+        // Return counter hash of row j, including any write in flight.
+        CounterT read_counter(const HashT &hash, int j) {
+            CounterT c = counters[hash][j];
+            for(int d = FORWARD-1; d >= 0; d--) {
+#pragma HLS unroll
+                if(last_valid[d][j] && last_hash[d][j] == hash) c = last_count[d][j];
+            }
+            return c;
+        }
+        // Add inc to the count for key.
+        // Return the new estimate for key.
+        CounterT update(const KeyT &key, const CounterT &inc) {
+#pragma HLS pipeline II=1
+#pragma HLS dependence variable=counters inter false
+            CounterT estimate = CounterT(-1);
+            for(int j = 0; j < ROWS; j++) {
+#pragma HLS unroll
+                HashT hash = hasher.hash(key, j);
+                CounterT c = read_counter(hash, j);
+                CounterT n = c + inc;
+                if(n < c) n = CounterT(-1); // saturate
+                counters[hash][j] = n;
+                for(int d = FORWARD-1; d > 0; d--) {
+                    last_hash[d][j] = last_hash[d-1][j];
+                    last_count[d][j] = last_count[d-1][j];
+                    last_valid[d][j] = last_valid[d-1][j];
+                }
+                last_hash[0][j] = hash;
+                last_count[0][j] = n;
+                last_valid[0][j] = true;
+                if(n < estimate) estimate = n;
+            }
+            return estimate;
+        }
+        // Return the estimated count for key.
+        CounterT query(const KeyT &key) {
+#pragma HLS pipeline II=1
+            CounterT estimate = CounterT(-1);
+            for(int j = 0; j < ROWS; j++) {
+#pragma HLS unroll
+                HashT hash = hasher.hash(key, j);
+                CounterT c = read_counter(hash, j);
+                if(c < estimate) estimate = c;
+            }
+            return estimate;
+        }
+    };
+
+    // Track the K keys with the largest counts in a stream, using a
+    // count_min_sketch to estimate the count of every key, and a small
+    // cam holding the current top K keys and their estimates.
+    // When a key which is not in the cam has a larger estimate than
+    // the smallest entry in the cam, then it replaces that entry.
+    template <int K, int ROWS, int COLS, typename CounterT, typename KeyT>
+    class heavy_hitter {
+    public:
+        typedef cam_record<KeyT, CounterT> RecordT;
+
+        count_min_sketch<ROWS, COLS, CounterT, KeyT> sketch;
+        cam<K, KeyT, CounterT> top;
+
+        void clear() {
+            sketch.clear();
+            top.clear();
+        }
+        // Add inc to the count for key.
+        // Return the new estimate for key.
+        CounterT update(const KeyT &key, const CounterT &inc) {
+#pragma HLS pipeline II=1
+            CounterT estimate = sketch.update(key, inc);
+            CounterT c;
+            if(top.get(key, c) || top.canInsert()) {
+                top.insert(key, estimate);
+            } else {
+                // Find the smallest entry.
+                KeyT minkey;
+                CounterT mincount = CounterT(-1);
+                for(int i = 0; i < K; i++) {
+#pragma HLS unroll
+                    KeyT k;
+                    CounterT v;
+                    top.get_entry(i, k, v);
+                    if(v < mincount) {
+                        minkey = k;
+                        mincount = v;
+                    }
+                }
+                if(estimate > mincount) {
+                    top.swap(minkey, key, estimate);
+                }
+            }
+            return estimate;
+        }
+        // Return true if key is currently one of the top K keys.
+        // In addition, return the estimated count for key.
+        bool get(const KeyT &key, CounterT &count) {
+            return top.get(key, count);
+        }
+        // Write the top K keys with an estimated count of at least threshold
+        // to out, setting last on the final record.
+        // Return the number of records written.
+        int report(hls::stream<RecordT> &out, const CounterT &threshold) {
+            int count = 0;
+            RecordT held;
+            bool held_valid = false;
+            for(int i = 0; i < K; i++) {
+#pragma HLS pipeline II=1
+                KeyT k;
+                CounterT v;
+                if(top.get_entry(i, k, v) && v >= threshold) {
+                    if(held_valid) out.write(held);
+                    held = RecordT(k, v);
+                    held_valid = true;
+                    count++;
+                }
+            }
+            if(held_valid) {
+                held.last = true;
+                out.write(held);
+            }
+            return count;
+        }
+    };
+}
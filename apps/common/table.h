@@ -0,0 +1,188 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "cam.h"
+
+namespace hls {
+
+    // Match kinds for match_action_table, which select the structure holding
+    // the table entries.
+    // Exact match in a fully associative cam.
+    template <int SIZE>
+    struct exact_match {
+        template <typename KeyT, typename ValueT>
+        struct table {
+            typedef cam<SIZE, KeyT, ValueT> type;
+        };
+    };
+    // Exact match in an algorithmic_cam.  migrate() must be called
+    // regularly to move new entries out of the insertion cache.
+    template <int SIZE, int FACTOR>
+    struct hash_match {
+        template <typename KeyT, typename ValueT>
+        struct table {
+            typedef algorithmic_cam<SIZE, FACTOR, KeyT, ValueT> type;
+        };
+    };
+    // Ternary match with priorities in a tcam.
+    template <int SIZE>
+    struct ternary_match {
+        template <typename KeyT, typename ValueT>
+        struct table {
+            typedef tcam<SIZE, KeyT, ValueT> type;
+        };
+    };
+    // Longest prefix match.
+    template <int SIZE>
+    struct lpm_match {
+        template <typename KeyT, typename ValueT>
+        struct table {
+            typedef lpm_cam<SIZE, KeyT, ValueT> type;
+        };
+    };
+
+    // Range match with priorities in a range_cam.
+    template <int SIZE>
+    struct range_match {
+        template <typename KeyT, typename ValueT>
+        struct table {
+            typedef range_cam<SIZE, KeyT, ValueT> type;
+        };
+    };
+
+    // An action which does nothing.
+    struct no_action {
+        template <typename ActionDataT, typename ContextT>
+        static void apply(const ActionDataT &data, ContextT &context) {}
+    };
+
+    // The result of a table lookup: the index of an action and its data.
+    template <typename ActionDataT>
+    struct action_entry {
+        ap_uint<8> action;
+        ActionDataT data;
+        action_entry() : action(0), data() {}
+        action_entry(int a, const ActionDataT &d) : action(a), data(d) {}
+    };
+    template <typename ActionDataT>
+    std::ostream& operator<<(std::ostream& os, const action_entry<ActionDataT>& e) {
+        return os << "action " << e.action;
+    }
+
+    // Call Actions[action]::apply(data, context).  An action index of
+    // sizeof...(Actions) or more does nothing.
+    template <typename ActionDataT, typename... Actions>
+    struct action_dispatch;
+    template <typename ActionDataT>
+    struct action_dispatch<ActionDataT> {
+        template <typename ContextT>
+        static void apply(int action, const ActionDataT &data, ContextT &context) {}
+    };
+    template <typename ActionDataT, typename A, typename... Rest>
+    struct action_dispatch<ActionDataT, A, Rest...> {
+        template <typename ContextT>
+        static void apply(int action, const ActionDataT &data, ContextT &context) {
+#pragma HLS inline
+            if(action == 0) {
+                A::apply(data, context);
+            } else {
+                action_dispatch<ActionDataT, Rest...>::apply(action - 1, data, context);
+            }
+        }
+    };
+
+    // A table which looks up a key and applies the action stored with the
+    // matching entry, in the style of a P4 match-action table.  MatchKind
+    // (exact_match, hash_match, ternary_match, lpm_match or range_match) selects the
+    // structure holding the entries.  Each entry holds the index of one of
+    // Actions and the ActionDataT passed to it.  Each action is a type with a
+    // static apply(const ActionDataT &, ContextT &) function, where ContextT
+    // is typically a packet header or metadata struct.  On a miss, the default
+    // action is applied, which does nothing until set_default() is called.
+    // Tables can be chained by applying them in sequence to the same context.
+    template <typename MatchKind, typename KeyT, typename ActionDataT, typename... Actions>
+    class match_action_table {
+    public:
+        const static int ACTIONS = sizeof...(Actions);
+        typedef action_entry<ActionDataT> EntryT;
+        typedef typename MatchKind::template table<KeyT, EntryT>::type TableT;
+
+        TableT entries;
+        EntryT default_entry;
+
+        match_action_table() : default_entry(ACTIONS, ActionDataT()) {}
+        void clear() {
+            entries.clear();
+        }
+        // Apply the given action when no entry matches.
+        void set_default(int action, const ActionDataT &data) {
+            assert(action < ACTIONS);
+            default_entry = EntryT(action, data);
+        }
+        // Add an entry for an exact match table.
+        // Return true if the operation succeeds or false if it fails.
+        bool add(const KeyT &key, int action, const ActionDataT &data) {
+            assert(action < ACTIONS);
+            return entries.insert(key, EntryT(action, data));
+        }
+        // Add an entry for a ternary table (where match is a mask), an lpm
+        // table (where match is a prefix length) or a range table (where key
+        // and match are the lower and upper bounds).
+        // Return true if the operation succeeds or false if it fails.
+        template <typename MatchT>
+        bool add(const KeyT &key, const MatchT &match, int action, const ActionDataT &data) {
+            assert(action < ACTIONS);
+            return entries.insert(key, match, EntryT(action, data));
+        }
+        // Add an entry with the given priority for a ternary or range table.
+        // Return true if the operation succeeds or false if it fails.
+        template <typename MatchT, typename PriorityT>
+        bool add(const KeyT &key, const MatchT &match, const PriorityT &priority,
+                 int action, const ActionDataT &data) {
+            assert(action < ACTIONS);
+            return entries.insert(key, match, EntryT(action, data), priority);
+        }
+        // Remove an entry from an exact match table.
+        bool remove(const KeyT &key) {
+            return entries.remove(key);
+        }
+        // Remove an entry from a ternary, lpm or range table.
+        template <typename MatchT>
+        bool remove(const KeyT &key, const MatchT &match) {
+            return entries.remove(key, match);
+        }
+        // Look up key and apply the action of the matching entry, or the
+        // default action if there is no match, to context.
+        // Return true if an entry matched.
+        template <typename ContextT>
+        bool apply(const KeyT &key, ContextT &context) {
+#pragma HLS inline
+            EntryT e;
+            bool hit = entries.get(key, e);
+            if(!hit) e = default_entry;
+            action_dispatch<ActionDataT, Actions...>::apply(e.action, e.data, context);
+            return hit;
+        }
+        // Move new entries into a hash_match table.  This is intended to be
+        // called once per cycle alongside apply().
+        bool migrate() {
+            return entries.migrate();
+        }
+    };
+}
@@ -17,11 +17,182 @@ limitations under the License.
 
 #include <vector>
 #include <set>
+#include <map>
 #include <iostream>
 #include "hls_stream.h"
 #include "allocator.h"
 
+// Allocate and deallocate several ids per call.
+void check_multi() {
+    const int N = 64;
+    const int K = 4;
+    typedef MultiAllocator<N, K> AllocatorT;
+    AllocatorT allocator;
+    std::set<int> myset;
+    for(int k = 0; k < 1000; k++) {
+        int ids[K];
+        int n = allocator.allocate(1 + rand() % K, ids);
+        for(int i = 0; i < n; i++) {
+            assert(ids[i] > 0 && ids[i] < N);
+            assert(ids[i] % (N/K) != 0);
+            assert(allocator.is_allocated(ids[i]));
+            assert(myset.count(ids[i]) == 0);
+            myset.insert(ids[i]);
+        }
+        // The allocations in one call come from different banks.
+        for(int i = 0; i < n; i++) {
+            for(int j = i+1; j < n; j++) {
+                assert(AllocatorT::bank_of(ids[i]) != AllocatorT::bank_of(ids[j]));
+            }
+        }
+        if((int)myset.size() == N-K) {
+            assert(allocator.allocate() == -1);
+        }
+
+        // Free some random allocated ids, retrying those which conflict.
+        ap_uint<K> valid = 0;
+        for(int i = 0; i < K; i++) {
+            int id = allocator.find_allocated();
+            if(id >= 0 && rand() % 2) {
+                bool duplicate = false;
+                for(int j = 0; j < i; j++) {
+                    if(valid[j] && ids[j] == id) duplicate = true;
+                }
+                if(!duplicate) {
+                    ids[i] = id;
+                    valid[i] = true;
+                }
+            }
+        }
+        while(valid != 0) {
+            ap_uint<K> done = allocator.deallocate(valid, ids);
+            assert(done != 0);
+            assert((done & ~valid) == 0);
+            for(int i = 0; i < K; i++) {
+                if(done[i]) {
+                    assert(myset.count(ids[i]) == 1);
+                    myset.erase(ids[i]);
+                    assert(!allocator.is_allocated(ids[i]));
+                }
+            }
+            valid &= ~done;
+        }
+        assert(allocator.size() == (int)myset.size());
+    }
+    std::cout << "MultiAllocator: " << myset.size() << " allocated\n";
+}
+
+// Allocate and deallocate in the same operation, including when there are no free ids.
+void check_allocate_and_free() {
+    const int N = 8;
+    Allocator<N> allocator;
+    std::set<int> myset;
+    for(int k = 0; k < 1000; k++) {
+        int free_id = -1;
+        if(myset.size() > 0 && rand() % 2) {
+            free_id = allocator.find_allocated();
+            assert(myset.count(free_id) == 1);
+        }
+        bool allocate_valid = rand() % 2;
+        bool full = (int)myset.size() == N-1;
+        int n = allocator.allocate_and_free(free_id, allocate_valid);
+        if(free_id >= 0) {
+            myset.erase(free_id);
+        }
+        if(allocate_valid && (free_id >= 0 || !full)) {
+            assert(n > 0 && n < N);
+            assert(myset.count(n) == 0);
+            myset.insert(n);
+        } else {
+            assert(n == -1);
+        }
+        assert(allocator.size() == (int)myset.size());
+        for(int i = 1; i < N; i++) {
+            assert(allocator.is_allocated(i) == (myset.count(i) == 1));
+        }
+    }
+}
+
+// Allocate and free ids in random order, checking that an id is never
+// allocated twice, including ids which are freed and reallocated soon after.
+void check_fifo() {
+    const int N = 16;
+    FifoAllocator<N> allocator;
+    std::vector<int> allocated;
+    std::set<int> myset;
+    for(int k = 0; k < 10000; k++) {
+        int free_id = -1;
+        if(!allocated.empty() && rand() % 2) {
+            int i = rand() % allocated.size();
+            free_id = allocated[i];
+            allocated.erase(allocated.begin() + i);
+            myset.erase(free_id);
+        }
+        bool allocate_valid = rand() % 2;
+        bool full = (int)myset.size() == N;
+        int n = allocator.allocate_and_free(free_id, allocate_valid);
+        if(allocate_valid && (free_id >= 0 || !full)) {
+            assert(n >= 0 && n < N);
+            assert(myset.count(n) == 0);
+            myset.insert(n);
+            allocated.push_back(n);
+        } else {
+            assert(n == -1);
+        }
+        assert(allocator.size() == (int)myset.size());
+        assert(allocator.canAllocate() == ((int)myset.size() < N));
+    }
+}
+
+// Store variable length messages and check that they are returned intact.
+void check_variable_message_buffer() {
+    typedef SlabAllocator<ap_uint<32>, 4, 8, 4> SlabT; // 8 regions each of 4, 8, 16 and 32 words.
+    static VariableMessageBuffer<ap_uint<32>, 16, 32, SlabT> buffer;
+    std::map<int, std::vector<unsigned> > model;
+    for(int k = 0; k < 2000; k++) {
+        if(rand() % 2) {
+            ap_uint<32> msg[32];
+            int length = 1 + rand() % 32;
+            std::vector<unsigned> v;
+            for(int i = 0; i < length; i++) {
+                msg[i] = rand();
+                v.push_back(msg[i]);
+            }
+            int id = buffer.put(msg, length);
+            if(id >= 0) {
+                assert(model.count(id) == 0);
+                model[id] = v;
+            } else {
+                assert(model.size() > 0);
+            }
+        } else {
+            ap_uint<32> msg[32];
+            int id;
+            int length = buffer.get(id, msg);
+            if(id < 0) {
+                assert(model.size() == 0);
+                continue;
+            }
+            assert(model.count(id) == 1);
+            assert(length == (int)model[id].size());
+            for(int i = 0; i < length; i++) {
+                assert(msg[i] == model[id][i]);
+            }
+            if(rand() % 2) {
+                buffer.clear(id);
+                model.erase(id);
+            }
+        }
+        assert(buffer.size() == (int)model.size());
+    }
+    std::cout << "VariableMessageBuffer: " << model.size() << " messages\n";
+}
+
 int main(int argv, char * argc[]) {
+    check_variable_message_buffer();
+    check_multi();
+    check_allocate_and_free();
+    check_fifo();
     const int N = 8;
     typedef std::set<int> SetT;
     SetT myset;
@@ -0,0 +1,139 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <map>
+#include <list>
+#include <iostream>
+#include "cache.h"
+
+typedef hls::set_assoc_cache<256, 4, ap_uint<32>, ap_uint<48> > ArpCacheT;
+
+// Look up a burst of addresses, filling in misses.
+void top(ap_uint<32> addresses[256], ap_uint<48> macs[256], bool hits[256]) {
+    static ArpCacheT arpcache;
+    for(int i = 0; i < 256; i++) {
+#pragma HLS pipeline II=1
+        ap_uint<48> mac;
+        hits[i] = arpcache.get(addresses[i], mac);
+        if(hits[i]) macs[i] = mac;
+        else arpcache.insert(addresses[i], macs[i]);
+    }
+}
+
+// Compare an LRU cache against a model which keeps each set in recency order.
+void check_lru() {
+    typedef hls::set_assoc_cache<16, 4, ap_uint<32>, ap_uint<32>, hls::lru_replacement> CacheT;
+    static CacheT cache;
+    std::map<int, std::list<std::pair<unsigned, unsigned> > > model;
+    int hits = 0, evictions = 0;
+    for(int i = 0; i < 20000; i++) {
+        ap_uint<32> key = rand() % 128;
+        int set = cache.hasher.hash(key, 0);
+        std::list<std::pair<unsigned, unsigned> > &s = model[set];
+        std::list<std::pair<unsigned, unsigned> >::iterator e = s.begin();
+        while(e != s.end() && e->first != key) e++;
+        if(rand() % 2) {
+            ap_uint<32> value;
+            bool hit = cache.get(key, value);
+            assert(hit == (e != s.end()));
+            if(hit) {
+                assert(value == e->second);
+                s.splice(s.begin(), s, e);
+                hits++;
+            }
+        } else {
+            ap_uint<32> value = rand();
+            ap_uint<32> evicted_key, evicted_value;
+            bool evicted;
+            assert(cache.insert(key, value, evicted_key, evicted_value, evicted));
+            if(e != s.end()) {
+                s.erase(e);
+                assert(!evicted);
+            } else if(s.size() == 4) {
+                assert(evicted);
+                assert(evicted_key == s.back().first);
+                assert(evicted_value == s.back().second);
+                s.pop_back();
+                evictions++;
+            } else {
+                assert(!evicted);
+            }
+            s.push_front(std::make_pair((unsigned)key, (unsigned)value));
+        }
+        if(rand() % 16 == 0) {
+            ap_uint<32> rkey = rand() % 128;
+            int rset = cache.hasher.hash(rkey, 0);
+            std::list<std::pair<unsigned, unsigned> > &rs = model[rset];
+            bool found = false;
+            for(e = rs.begin(); e != rs.end(); e++) {
+                if(e->first == rkey) {
+                    rs.erase(e);
+                    found = true;
+                    break;
+                }
+            }
+            assert(cache.remove(rkey) == found);
+        }
+    }
+    std::cout << "LRU: " << hits << " hits, " << evictions << " evictions\n";
+}
+
+// Check that a cache with the given policy never loses an entry
+// except by reporting it as evicted.
+template <typename Policy>
+void check_policy(bool replace) {
+    typedef hls::set_assoc_cache<16, 4, ap_uint<32>, ap_uint<32>, Policy> CacheT;
+    static CacheT cache;
+    std::map<unsigned, unsigned> model;
+    int failed = 0;
+    for(int i = 0; i < 5000; i++) {
+        ap_uint<32> key = rand() % 256;
+        ap_uint<32> value = rand();
+        ap_uint<32> evicted_key, evicted_value;
+        bool evicted;
+        if(cache.insert(key, value, evicted_key, evicted_value, evicted)) {
+            if(evicted) {
+                assert(replace);
+                assert(model[evicted_key] == evicted_value);
+                model.erase(evicted_key);
+            }
+            model[key] = value;
+        } else {
+            assert(!replace);
+            assert(!cache.canInsert(key));
+            failed++;
+        }
+        ap_uint<32> v;
+        cache.get(rand() % 256, v);
+    }
+    for(unsigned key = 0; key < 256; key++) {
+        ap_uint<32> value;
+        bool hit = cache.get(key, value);
+        assert(hit == (model.count(key) != 0));
+        if(hit) assert(value == model[key]);
+    }
+    assert(model.size() <= 16*4);
+    std::cout << model.size() << " entries, " << failed << " failed inserts\n";
+}
+
+int main(int argv, char * argc[]) {
+    check_lru();
+    check_policy<hls::lru_replacement>(true);
+    check_policy<hls::plru_replacement>(true);
+    check_policy<hls::random_replacement>(true);
+    check_policy<hls::no_replacement>(false);
+}
@@ -18,6 +18,7 @@ limitations under the License.
 #include "cam.h"
 #include <map>
 #include <vector>
+#include <deque>
 #include <iostream>
 #include "hls_stream.h"
 const static int N = 32768;
@@ -174,7 +175,299 @@ void check_consistency(MapT mymap, CamT mycam) {
         assert(b);
     }
 }
+// Fill a small cam with replacement beyond its capacity, keeping the
+// entries at 0 and 1 hot.  The hot entries should never be evicted.
+template <typename Policy>
+void check_replacement(bool exact) {
+    std::cout << "Checking replacement...\n";
+    hls::cam<4, ap_uint<32>, ap_uint<8>, Policy> mycam;
+    for(int i = 0; i < 64; i++) {
+        bool b = mycam.insert(i, i);
+        assert(b);
+        ap_uint<8> v;
+        b = mycam.get(i, v);
+        assert(b && v == i);
+        if(i == 0) continue;
+        bool hot0 = mycam.get(0, v, true);
+        bool hot1 = (i < 2) || mycam.get(1, v, true);
+        if(exact) assert(hot0 && hot1);
+    }
+}
+
+// Promote an entry after removing another, which leaves a gap in front
+// of the promoted entry.
+void check_promote_after_remove() {
+    std::cout << "Checking promote after remove...\n";
+    hls::cam<4, ap_uint<32>, ap_uint<8>, hls::lru_replacement> mycam;
+    for(int i = 1; i <= 3; i++) assert(mycam.insert(i, i*10));
+    assert(mycam.remove(3));
+    ap_uint<8> v;
+    assert(mycam.get(1, v, true) && v == 10);
+    assert(mycam.get(1, v) && v == 10);
+    assert(mycam.get(2, v) && v == 20);
+    assert(!mycam.get(3, v));
+}
+
+// Issue a random mix of back-to-back requests to a pipelined cam and
+// check the replies against a reference model.
+void check_pipelined() {
+    std::cout << "Checking pipelined cam...\n";
+    typedef hls::pipelined_cam<64, ap_uint<32>, ap_uint<8>, 4, 16> CamT;
+    CamT mycam;
+    std::map<ap_uint<32>, ap_uint<8> > mymap;
+    std::deque<CamT::Reply> expected;
+    for(int i = 0; i < 10000; i++) {
+        bool req_valid = (rand() % 4) != 0;
+        CamT::Request req(rand() % 80, rand(), rand() % 3);
+        if(req_valid) {
+            CamT::Reply e;
+            e.key = req.key;
+            e.op = req.op;
+            if(req.op == CamT::LOOKUP) {
+                e.hit = mymap.count(req.key);
+                if(e.hit) e.value = mymap[req.key];
+            } else if(req.op == CamT::INSERT) {
+                e.hit = mymap.count(req.key) || mymap.size() < 64;
+                if(e.hit) mymap[req.key] = req.value;
+            } else {
+                e.hit = mymap.erase(req.key);
+            }
+            expected.push_back(e);
+        }
+        CamT::Reply reply;
+        if(mycam.process(req_valid, req, reply)) {
+            CamT::Reply e = expected.front();
+            expected.pop_front();
+            assert(reply.key == e.key && reply.op == e.op);
+            assert(reply.hit == e.hit);
+            if(reply.op == CamT::LOOKUP && reply.hit) assert(reply.value == e.value);
+        }
+    }
+}
+
+// Save a table to an image and restore it into a new table.
+void check_snapshot() {
+    std::cout << "Checking snapshot...\n";
+    typedef hls::algorithmic_cam<64, 4, ap_uint<32>, ap_uint<8> > CamT;
+    CamT mycam;
+    std::map<ap_uint<32>, ap_uint<8> > mymap;
+    for(int i = 0; i < 40; i++) {
+        ap_uint<32> k = rand();
+        ap_uint<8> v = rand();
+        assert(mycam.insert(k, v));
+        // Leave the last few entries in the cache.
+        for(int j = 0; j < 4 && i < 38; j++) mycam.sweep();
+        mymap[k] = v;
+    }
+    static ap_uint<32> image[CamT::MAX_IMAGE_WORDS];
+    int words = mycam.save(image);
+    assert(words <= CamT::MAX_IMAGE_WORDS);
+
+    // The new table has different hash functions until it is restored.
+    CamT restored(image);
+    check_consistency(mymap, restored);
+    ap_uint<8> v;
+    assert(!restored.get(~mymap.begin()->first, v));
+
+    // An image from a table with different parameters is rejected.
+    hls::algorithmic_cam<64, 4, ap_uint<32>, ap_uint<16> > other;
+    assert(!other.restore(image));
+}
+
+// Age a table with some entries in the banks and some in the cache, keeping
+// one entry hot.  Every other entry should expire on the pass of the aging
+// hand which reaches the timeout, and not before.
+void check_aging() {
+    std::cout << "Checking aging...\n";
+    typedef hls::algorithmic_cam<64, 4, ap_uint<32>, ap_uint<8> > CamT;
+    const int SLOTS = CamT::BANKSIZE*CamT::HASHES + 4;
+    const int PERIOD = 3;
+    const int TIMEOUT = 3;
+    CamT mycam;
+    std::map<ap_uint<32>, ap_uint<8> > mymap;
+    mycam.set_aging(PERIOD, TIMEOUT, true);
+    for(int i = 1; i <= 12; i++) {
+        assert(mycam.insert(i, i*3));
+        // Leave the last two entries in the cache.
+        for(int j = 0; j < 4 && i <= 10; j++) mycam.sweep();
+        mymap[i] = i*3;
+    }
+    for(int i = 1; i <= PERIOD*SLOTS*TIMEOUT; i++) {
+        ap_uint<8> v;
+        assert(mycam.get(1, v) && v == 3);
+        ap_uint<32> k;
+        if(mycam.age(k, v)) {
+            assert(i > PERIOD*SLOTS*(TIMEOUT-1));
+            assert(k != 1 && mymap.count(k) && mymap[k] == v);
+            mymap.erase(k);
+        }
+    }
+    assert(mymap.size() == 1);
+    for(int i = 2; i <= 12; i++) {
+        ap_uint<8> v;
+        assert(!mycam.get(i, v));
+    }
+}
+
+// Issue lookups on every port of a multiport cam in every cycle while
+// inserting and removing entries.  Updates must still drain from the stash.
+void check_multiport() {
+    std::cout << "Checking multiport cam...\n";
+    const int PORTS = 3;
+    typedef hls::multiport_algorithmic_cam<64, 4, PORTS, ap_uint<32>, ap_uint<8> > CamT;
+    CamT mycam;
+    std::map<ap_uint<32>, ap_uint<8> > mymap;
+    std::vector<ap_uint<32> > removed;
+    int pending = 0;
+    for(int i = 0; i < 1000; i++) {
+        ap_uint<32> keys[PORTS];
+        ap_uint<8> values[PORTS];
+        for(int p = 0; p < PORTS; p++) keys[p] = rand() % 48;
+        ap_uint<PORTS> hits = mycam.get_all(keys, values, -1);
+        for(int p = 0; p < PORTS; p++) {
+            if(mymap.count(keys[p])) assert(hits[p] && values[p] == mymap[keys[p]]);
+        }
+        if(i < 400 && pending == 0) {
+            ap_uint<32> k = rand() % 48;
+            ap_uint<8> v = rand();
+            if(mymap.count(k) && mycam.remove(k)) {
+                mymap.erase(k);
+                removed.push_back(k);
+            } else if(!mymap.count(k) && mycam.insert(k, v)) {
+                mymap[k] = v;
+            }
+            pending = 8;
+        }
+        if(pending) pending--;
+        mycam.migrate();
+    }
+    // Every update has completed, despite the busy lookup ports.
+    assert(mycam.canInsert());
+    check_consistency(mymap, mycam.replicas[PORTS-1]);
+    for(int i = 0; i < removed.size(); i++) {
+        ap_uint<8> v;
+        if(!mymap.count(removed[i])) assert(!mycam.get(0, removed[i], v));
+    }
+}
+
+// Insert many more entries than fit in the cache of a two_level_cam, then
+// check that they are written back to external memory and reloaded.
+void check_two_level() {
+    std::cout << "Checking two level cam...\n";
+    typedef hls::two_level_cam<256, 4, 16, ap_uint<32>, ap_uint<8> > CamT;
+    static CamT::entry mem[256];
+    CamT mycam;
+    std::map<ap_uint<32>, ap_uint<8> > mymap;
+    mycam.clear(mem);
+    for(int i = 0; i < 100; i++) {
+        ap_uint<32> k = rand();
+        ap_uint<8> v = rand();
+        assert(mycam.insert(k, v, mem));
+        mycam.sweep(mem);
+        mymap[k] = v;
+    }
+    assert(mycam.overflows == 0);
+    // Age everything out of the cache.
+    for(int i = 0; i < 1000; i++) mycam.sweep(mem);
+    int written = 0;
+    for(int i = 0; i < 256; i++) {
+        if(mem[i].valid) {
+            assert(mymap.count(mem[i].key) && mymap[mem[i].key] == mem[i].value);
+            written++;
+        }
+    }
+    assert(written == mymap.size());
+    for(std::map<ap_uint<32>, ap_uint<8> >::iterator i = mymap.begin(); i != mymap.end(); i++) {
+        ap_uint<8> v;
+        assert(mycam.get(i->first, v, mem) && v == i->second);
+    }
+    // Modify a reloaded entry and check that the new value is written back.
+    ap_uint<32> k = mymap.begin()->first;
+    ap_uint<8> v;
+    assert(mycam.get(k, v, mem));
+    for(int i = 0; i < 8; i++) mycam.sweep(mem);
+    assert(mycam.insert(k, v+1, mem));
+    for(int i = 0; i < 1000; i++) mycam.sweep(mem);
+    CamT::entry e;
+    int free_address;
+    assert(mycam.read_buckets(k, mem, e, free_address) >= 0 && e.value == ap_uint<8>(v+1));
+}
+
+// Insert entries and flush immediately, while they are still in the
+// insertion cache, and check that they reach external memory.
+void check_flush() {
+    std::cout << "Checking flush...\n";
+    typedef hls::two_level_cam<256, 4, 16, ap_uint<32>, ap_uint<8> > CamT;
+    static CamT::entry mem[256];
+    CamT mycam;
+    mycam.clear(mem);
+    assert(mycam.insert(5, 7, mem));
+    mycam.flush(mem);
+    CamT::entry e;
+    int free_address;
+    assert(mycam.read_buckets(5, mem, e, free_address) >= 0 && e.value == 7);
+    assert(mycam.insert(5, 8, mem));
+    for(int i = 0; i < 3; i++) assert(mycam.insert(10+i, 20+i, mem));
+    mycam.flush(mem);
+    for(int i = 0; i < 3; i++) {
+        assert(mycam.read_buckets(10+i, mem, e, free_address) >= 0 && e.value == 20+i);
+    }
+    assert(mycam.read_buckets(5, mem, e, free_address) >= 0 && e.value == 8);
+    ap_uint<8> v;
+    assert(mycam.get(5, v, mem) && v == 8);
+}
+
+// Check that migrate() moves an entry every two calls, and that inserting
+// a key again while its remove() is pending keeps the new entry.
+void check_migrate() {
+    std::cout << "Checking migrate...\n";
+    hls::algorithmic_cam<64, 4, ap_uint<32>, ap_uint<8> > mycam;
+    for(int i = 0; i < 4; i++) assert(mycam.insert(i, i));
+    assert(!mycam.canInsert());
+    for(int i = 0; i < 8; i++) mycam.migrate();
+    for(int i = 4; i < 8; i++) assert(mycam.insert(i, i));
+    for(int i = 0; i < 8; i++) mycam.migrate();
+    ap_uint<8> v;
+    for(int i = 0; i < 8; i++) assert(mycam.get(i, v) && v == i);
+
+    // Insert while the remove is writing back.
+    assert(mycam.remove(1));
+    mycam.migrate();
+    assert(mycam.insert(1, 11));
+    for(int i = 0; i < 8; i++) mycam.migrate();
+    assert(mycam.get(1, v) && v == 11);
+    // Insert before the remove has started.
+    assert(mycam.remove(2));
+    assert(mycam.insert(2, 12));
+    for(int i = 0; i < 8; i++) mycam.migrate();
+    assert(mycam.get(2, v) && v == 12);
+    // A plain remove still completes.
+    assert(mycam.remove(3));
+    for(int i = 0; i < 8; i++) mycam.migrate();
+    assert(!mycam.get(3, v));
+}
+
 int main(int argv, char * argc[]) {
+    check_promote_after_remove();
+    check_migrate();
+    check_two_level();
+    check_flush();
+    check_multiport();
+    check_aging();
+    check_snapshot();
+    check_pipelined();
+    check_replacement<hls::lru_replacement>(true);
+    check_replacement<hls::plru_replacement>(true);
+    check_replacement<hls::random_replacement>(false);
+    {
+        // Without replacement, inserting into a full cam fails.
+        hls::cam<4, ap_uint<32>, ap_uint<8> > mycam;
+        for(int i = 0; i < 4; i++) {
+            assert(mycam.insert(i, i));
+        }
+        assert(!mycam.canInsert());
+        assert(!mycam.insert(4, 4));
+    }
     // const int N = 16;
     // hls::cam<N, ap_uint<32>, ap_uint<8> > mycam;
     const int N = 64;
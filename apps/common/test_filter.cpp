@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <set>
+#include <iostream>
+#include "filter.h"
+
+const static int N = 1024;
+
+typedef hls::bloom_filter<8*N, 4, ap_uint<32> > BloomT;
+typedef hls::cuckoo_filter<N/4, 4, 12, ap_uint<32> > CuckooT;
+
+// Return true for keys which have been seen before.
+void top(ap_uint<32> keys[64], bool seen[64]) {
+    static BloomT filter;
+    for(int i = 0; i < 64; i++) {
+#pragma HLS pipeline II=1
+        seen[i] = filter.test_and_insert(keys[i]);
+    }
+}
+
+int main(int argv, char * argc[]) {
+    std::set<ap_uint<32> > myset;
+    while(myset.size() < N/2) {
+        myset.insert(rand());
+    }
+
+    static BloomT bloom;
+    for(std::set<ap_uint<32> >::iterator i = myset.begin(); i != myset.end(); i++) {
+        bloom.insert(*i);
+    }
+    int falsepositives = 0;
+    for(int i = 0; i < 10000; i++) {
+        ap_uint<32> k = rand();
+        if(myset.count(k)) {
+            assert(bloom.contains(k));
+        } else if(bloom.contains(k)) {
+            falsepositives++;
+        }
+    }
+    for(std::set<ap_uint<32> >::iterator i = myset.begin(); i != myset.end(); i++) {
+        assert(bloom.contains(*i));
+    }
+    std::cout << "bloom filter false positives: " << falsepositives << "/10000\n";
+    assert(falsepositives < 100);
+
+    static CuckooT cuckoo;
+    for(std::set<ap_uint<32> >::iterator i = myset.begin(); i != myset.end(); i++) {
+        while(!cuckoo.insert(*i)) {
+            cuckoo.sweep();
+        }
+    }
+    for(std::set<ap_uint<32> >::iterator i = myset.begin(); i != myset.end(); i++) {
+        assert(cuckoo.contains(*i));
+    }
+    falsepositives = 0;
+    for(int i = 0; i < 10000; i++) {
+        ap_uint<32> k = rand();
+        if(!myset.count(k) && cuckoo.contains(k)) {
+            falsepositives++;
+        }
+    }
+    std::cout << "cuckoo filter false positives: " << falsepositives << "/10000\n";
+    assert(falsepositives < 100);
+
+    // Remove half of the keys.
+    std::set<ap_uint<32> > removed;
+    for(std::set<ap_uint<32> >::iterator i = myset.begin(); i != myset.end();) {
+        if(rand() & 1) {
+            assert(cuckoo.remove(*i));
+            removed.insert(*i);
+            myset.erase(i++);
+        } else {
+            i++;
+        }
+    }
+    for(std::set<ap_uint<32> >::iterator i = myset.begin(); i != myset.end(); i++) {
+        assert(cuckoo.contains(*i));
+    }
+    int remaining = 0;
+    for(std::set<ap_uint<32> >::iterator i = removed.begin(); i != removed.end(); i++) {
+        if(cuckoo.contains(*i)) remaining++;
+    }
+    std::cout << "removed keys still reported: " << remaining << "/" << removed.size() << "\n";
+    assert(remaining < 10);
+
+    ap_uint<32> keys[64];
+    bool seen[64];
+    for(int i = 0; i < 64; i++) {
+        keys[i] = i % 32;
+    }
+    top(keys, seen);
+    for(int i = 0; i < 64; i++) {
+        assert(seen[i] == (i >= 32));
+    }
+}
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <map>
+#include <iostream>
+#include "flow_table.h"
+
+typedef hls::flow_table<1024, 4> FlowTableT;
+
+// Account for a burst of packets, exporting flows which have been idle
+// for 1000 cycles.
+void top(hls::five_tuple keys[256], ap_uint<16> lengths[256], ap_uint<32> now,
+         hls::stream<FlowTableT::RecordT> &expired) {
+    static FlowTableT flows;
+    flows.set_timeouts(1000, 0);
+    for(int i = 0; i < 256; i++) {
+#pragma HLS pipeline II=1
+        flows.update(keys[i], lengths[i], now + i);
+        flows.expire(now + i, expired);
+    }
+}
+
+struct Totals {
+    unsigned packets;
+    unsigned bytes;
+};
+
+int main(int argv, char * argc[]) {
+    static FlowTableT flows;
+    flows.set_timeouts(10000, 0);
+    hls::stream<FlowTableT::RecordT> expired;
+    std::map<hls::five_tuple, Totals> totals;
+    std::map<hls::five_tuple, Totals> exported;
+    unsigned failed = 0;
+    ap_uint<32> now = 0;
+    const int FLOWS = 300;
+
+    for(int i = 0; i < 20000; i++) {
+        // Back-to-back packets of the same flow are common.
+        int f = (i % 3 == 0) ? (i / 3) % 7 : rand() % FLOWS;
+        hls::five_tuple key = hls::make_five_tuple(0x0a000000 + f, 0x0a0000ff, 1024 + f, 80, 17);
+        ap_uint<16> length = 64 + rand() % 1400;
+        if(flows.update(key, length, now)) {
+            totals[key].packets++;
+            totals[key].bytes += length;
+        } else {
+            failed++;
+        }
+        flows.expire(now, expired);
+        now++;
+    }
+    assert(expired.empty());
+    assert(flows.untracked == failed);
+    std::cout << totals.size() << " flows, " << failed << " untracked packets\n";
+
+    // Current flows can be read back.
+    for(std::map<hls::five_tuple, Totals>::iterator i = totals.begin(); i != totals.end(); i++) {
+        FlowTableT::RecordT r;
+        assert(flows.get(i->first, r));
+        assert(r.packets == i->second.packets);
+        assert(r.bytes == i->second.bytes);
+    }
+
+    // Let everything go idle and check that every flow is exported exactly once.
+    for(int i = 0; i < 20000; i++) {
+        flows.expire(now, expired);
+        now++;
+    }
+    while(!expired.empty()) {
+        FlowTableT::RecordT r = expired.read();
+        assert(exported.count(r.key) == 0);
+        assert(r.first_seen <= r.last_seen);
+        exported[r.key].packets = r.packets;
+        exported[r.key].bytes = r.bytes;
+    }
+    assert(exported.size() == totals.size());
+    for(std::map<hls::five_tuple, Totals>::iterator i = totals.begin(); i != totals.end(); i++) {
+        assert(exported[i->first].packets == i->second.packets);
+        assert(exported[i->first].bytes == i->second.bytes);
+        FlowTableT::RecordT r;
+        assert(!flows.get(i->first, r));
+    }
+    std::cout << exported.size() << " flows exported\n";
+}
@@ -0,0 +1,259 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <vector>
+#include <deque>
+#include <iostream>
+#include "packet_buffer.h"
+
+typedef hls::packet_buffer_pool<8, 64, 2048> PoolT;
+
+// Store packets and forward their descriptors, loading each packet from
+// the buffer when its descriptor is returned.
+void top(hls::stream<PoolT::BeatT> &input, hls::stream<hls::packet_descriptor> &descriptors,
+         hls::stream<hls::packet_descriptor> &to_send, hls::stream<PoolT::BeatT> &output) {
+    static PoolT pool;
+    static PoolT::WordT memory[PoolT::WORDS];
+    if(!input.empty()) pool.store(input, descriptors, memory);
+    if(!to_send.empty()) pool.load(to_send, output, memory);
+}
+
+void send_packet(hls::stream<PoolT::BeatT> &s, const std::vector<unsigned char> &p) {
+    for(int i = 0; i < (int)p.size(); i += 8) {
+        PoolT::BeatT t;
+        t.data = 0;
+        t.keep = 0;
+        for(int j = 0; j < 8 && i+j < (int)p.size(); j++) {
+            t.data(8*j+7, 8*j) = p[i+j];
+            t.keep[j] = 1;
+        }
+        t.last = i + 8 >= (int)p.size();
+        s.write(t);
+    }
+}
+
+std::vector<unsigned char> receive_packet(hls::stream<PoolT::BeatT> &s) {
+    std::vector<unsigned char> p;
+    PoolT::BeatT t;
+    do {
+        t = s.read();
+        for(int j = 0; j < 8; j++) {
+            if(t.keep[j]) p.push_back(t.data(8*j+7, 8*j));
+        }
+    } while(!t.last);
+    return p;
+}
+
+// Return a packet of the given number of beats, each with a random
+// nonzero subset of its bytes kept.
+std::vector<PoolT::BeatT> sparse_packet(int beats) {
+    std::vector<PoolT::BeatT> p(beats);
+    for(int i = 0; i < beats; i++) {
+        p[i].data = ((ap_uint<64>)rand() << 32) | rand();
+        p[i].keep = 1 + rand() % 255;
+        p[i].last = i == beats-1;
+    }
+    return p;
+}
+
+int sparse_length(const std::vector<PoolT::BeatT> &p) {
+    int length = 0;
+    for(int i = 0; i < (int)p.size(); i++) length += hls::kept_bytes<8>(p[i].keep);
+    return length;
+}
+
+// Check that the next packet in s matches p beat for beat.
+void check_beats(hls::stream<PoolT::BeatT> &s, const std::vector<PoolT::BeatT> &p) {
+    for(int i = 0; i < (int)p.size(); i++) {
+        PoolT::BeatT t = s.read();
+        for(int j = 0; j < 8; j++) {
+            if(p[i].keep[j]) assert(t.data(8*j+7, 8*j) == p[i].data(8*j+7, 8*j));
+        }
+        assert(t.keep == p[i].keep);
+        assert(t.last == p[i].last);
+    }
+    assert(s.empty());
+}
+
+// Store packets whose beats are not full, and check that they are loaded
+// unchanged, and that a packet with more beats than fit in a buffer is
+// dropped even if its length would fit.
+void check_sparse_pool() {
+    static PoolT pool;
+    static PoolT::WordT memory[PoolT::WORDS];
+    hls::stream<PoolT::BeatT> input, output;
+    hls::stream<hls::packet_descriptor> descriptors;
+    for(int k = 0; k < 100; k++) {
+        std::vector<PoolT::BeatT> p = sparse_packet(1 + rand() % 300);
+        for(int i = 0; i < (int)p.size(); i++) input.write(p[i]);
+        bool b = pool.store(input, descriptors, memory);
+        assert(input.empty());
+        assert(b == (p.size() <= 256 && sparse_length(p) <= 2048));
+        if(b) {
+            hls::packet_descriptor d = descriptors.read();
+            assert(d.length == sparse_length(p));
+            pool.load(d, output, memory);
+            check_beats(output, p);
+        }
+    }
+    assert(pool.size() == 0);
+}
+
+// Store packets in chains of cells, with mostly small packets, and check that
+// many more packets can be buffered than with MTU-sized buffers.
+void check_chained() {
+    typedef hls::chained_packet_buffer<8, 512, 256> BufferT;
+    static BufferT buffer;
+    static BufferT::WordT memory[BufferT::WORDS];
+    hls::stream<PoolT::BeatT> input, output;
+    hls::stream<hls::packet_descriptor> descriptors;
+    std::deque<std::pair<hls::packet_descriptor, std::vector<unsigned char> > > stored;
+    int maxstored = 0;
+    for(int k = 0; k < 5000; k++) {
+        if(rand() % 3) {
+            int length = (rand() % 8) ? 64 + rand() % 200 : 1 + rand() % 9000;
+            std::vector<unsigned char> p(length);
+            for(int i = 0; i < (int)p.size(); i++) p[i] = rand();
+            send_packet(input, p);
+            int needed = (length + 255)/256;
+            bool fits = buffer.size() + needed <= 511;
+            bool b = buffer.store(input, descriptors, memory);
+            assert(input.empty());
+            assert(b == fits);
+            if(b) {
+                hls::packet_descriptor d = descriptors.read();
+                assert(d.length == p.size());
+                stored.push_back(std::make_pair(d, p));
+            }
+        } else if(!stored.empty()) {
+            int i = rand() % stored.size();
+            std::swap(stored[i], stored.front());
+            hls::packet_descriptor d = stored.front().first;
+            int n = 1 + rand() % 2;
+            buffer.retain(d, n-1);
+            for(int j = 0; j < n; j++) {
+                buffer.load(d, output, memory);
+                assert(receive_packet(output) == stored.front().second);
+            }
+            stored.pop_front();
+        }
+        if((int)stored.size() > maxstored) maxstored = stored.size();
+    }
+    while(!stored.empty()) {
+        buffer.release(stored.front().first);
+        stored.pop_front();
+    }
+    assert(buffer.size() == 0);
+    std::cout << "Chained: up to " << maxstored << " packets stored, " << buffer.dropped << " dropped\n";
+}
+
+// Store packets whose beats are not full, so that they use more cells than
+// their length implies, and check that they are loaded unchanged and that
+// releasing or loading them frees all their cells.
+void check_partial_beats() {
+    typedef hls::chained_packet_buffer<8, 512, 256> BufferT;
+    static BufferT buffer;
+    static BufferT::WordT memory[BufferT::WORDS];
+    hls::stream<PoolT::BeatT> input, output;
+    hls::stream<hls::packet_descriptor> descriptors;
+    for(int k = 0; k < 2; k++) {
+        std::vector<PoolT::BeatT> p(40);
+        for(int i = 0; i < 40; i++) {
+            p[i].data = 0x0101010101010101ULL*i;
+            p[i].keep = 0x0F;
+            p[i].last = i == 39;
+            input.write(p[i]);
+        }
+        assert(buffer.store(input, descriptors, memory));
+        hls::packet_descriptor d = descriptors.read();
+        assert(d.length == 160 && buffer.size() == 2);
+        if(k == 0) {
+            buffer.release(d);
+        } else {
+            buffer.load(d, output, memory);
+            check_beats(output, p);
+        }
+        assert(buffer.size() == 0);
+    }
+    // Four beats of one byte each.
+    std::vector<PoolT::BeatT> p(4);
+    for(int i = 0; i < 4; i++) {
+        p[i].data = 0xa0 + i;
+        p[i].keep = 1;
+        p[i].last = i == 3;
+        input.write(p[i]);
+    }
+    assert(buffer.store(input, descriptors, memory));
+    buffer.load(descriptors.read(), output, memory);
+    check_beats(output, p);
+    for(int k = 0; k < 100; k++) {
+        p = sparse_packet(1 + rand() % 100);
+        for(int i = 0; i < (int)p.size(); i++) input.write(p[i]);
+        assert(buffer.store(input, descriptors, memory));
+        hls::packet_descriptor d = descriptors.read();
+        assert(d.length == sparse_length(p));
+        buffer.load(d, output, memory);
+        check_beats(output, p);
+    }
+    assert(buffer.size() == 0);
+}
+
+int main(int argv, char * argc[]) {
+    check_sparse_pool();
+    check_partial_beats();
+    check_chained();
+    static PoolT pool;
+    static PoolT::WordT memory[PoolT::WORDS];
+    hls::stream<PoolT::BeatT> input, output;
+    hls::stream<hls::packet_descriptor> descriptors;
+    std::deque<std::pair<hls::packet_descriptor, std::vector<unsigned char> > > stored;
+    int sent = 0, copies = 0;
+
+    for(int k = 0; k < 5000; k++) {
+        if(rand() % 2) {
+            std::vector<unsigned char> p(1 + rand() % 2100);
+            for(int i = 0; i < (int)p.size(); i++) p[i] = rand();
+            send_packet(input, p);
+            bool full = pool.size() == 63;
+            bool b = pool.store(input, descriptors, memory);
+            assert(input.empty());
+            assert(b == (!full && p.size() <= 2048));
+            if(b) {
+                hls::packet_descriptor d = descriptors.read();
+                assert(d.length == p.size());
+                stored.push_back(std::make_pair(d, p));
+            }
+        } else if(!stored.empty()) {
+            // Take a random packet, and send one or more copies of it.
+            int i = rand() % stored.size();
+            std::swap(stored[i], stored.front());
+            hls::packet_descriptor d = stored.front().first;
+            int n = 1 + rand() % 3;
+            pool.retain(d, n-1);
+            for(int j = 0; j < n; j++) {
+                pool.load(d, output, memory);
+                assert(receive_packet(output) == stored.front().second);
+                assert(output.empty());
+                copies++;
+            }
+            stored.pop_front();
+            sent++;
+        }
+        assert(pool.size() == (int)stored.size());
+    }
+    std::cout << sent << " packets sent as " << copies << " copies, " << pool.dropped << " dropped\n";
+}
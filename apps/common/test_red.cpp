@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <iostream>
+#include "red.h"
+
+typedef hls::red<4> RedT;
+
+// Decide which of a stream of packets to drop.
+void top(ap_uint<2> queues[64], ap_uint<32> depths[64], bool drop[64]) {
+    static RedT aqm;
+    for(int i = 0; i < 64; i++) {
+#pragma HLS pipeline II=1
+        drop[i] = aqm.congested(queues[i], depths[i]);
+    }
+}
+
+// Return the fraction of packets dropped at a constant depth.
+double drop_rate(RedT &aqm, int q, int depth) {
+    aqm.clear();
+    // Let the average settle.
+    for(int k = 0; k < 10000; k++) aqm.congested(q, depth);
+    assert(aqm.average_depth(q) >= depth - 2 && aqm.average_depth(q) <= depth);
+    int drops = 0;
+    const int PACKETS = 100000;
+    for(int k = 0; k < PACKETS; k++) {
+        if(aqm.congested(q, depth)) drops++;
+    }
+    return double(drops) / PACKETS;
+}
+
+int main() {
+    RedT aqm;
+
+    // RED is disabled by default.
+    assert(drop_rate(aqm, 0, 1000000) == 0);
+
+    // Queue 0 drops up to 10% between 10000 and 30000 bytes, and
+    // queue 1 drops up to 50% between 5000 and 10000 bytes.
+    aqm.set_min_threshold(0, 10000);
+    aqm.set_max_threshold(0, 30000);
+    aqm.set_max_probability(0, 6554);
+    aqm.set_min_threshold(1, 5000);
+    aqm.set_max_threshold(1, 10000);
+    aqm.set_max_probability(1, 32768);
+
+    assert(drop_rate(aqm, 0, 5000) == 0);
+    assert(drop_rate(aqm, 0, 31000) == 1);
+    double p0 = drop_rate(aqm, 0, 20000);
+    double p1 = drop_rate(aqm, 1, 7500);
+    std::cout << "Drop rates " << p0 << " " << p1 << "\n";
+    assert(p0 > 0.04 && p0 < 0.06);
+    assert(p1 > 0.23 && p1 < 0.27);
+
+    // The average follows the depth slowly.
+    aqm.clear();
+    aqm.set_weight(4);
+    aqm.congested(2, 16000);
+    assert(aqm.average_depth(2) == 1000);
+
+    std::cout << "RED tests passed\n";
+}
@@ -0,0 +1,138 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <iostream>
+#include <deque>
+#include "hls_stream.h"
+#include "scheduler.h"
+
+typedef hls::scheduler<4> SchedulerT;
+
+// Schedule packets from 4 queues with the given lengths.
+void top(bool nonempty[64][4], ap_uint<16> length[64][4], hls::stream<int> &sent) {
+    static SchedulerT s;
+    s.set_mode(hls::DEFICIT_ROUND_ROBIN);
+    for(int i = 0; i < 64; i++) {
+#pragma HLS pipeline II=1
+        int q = s.schedule(nonempty[i], length[i], true);
+        if(q >= 0) sent.write(q);
+    }
+}
+
+// Keep all queues backlogged with random length packets, and return the
+// number of bytes sent from each queue.
+void run(SchedulerT &s, long bytes[4], int calls) {
+    std::deque<int> queues[4];
+    for(int i = 0; i < 4; i++) bytes[i] = 0;
+    for(int k = 0; k < calls; k++) {
+        bool nonempty[4];
+        ap_uint<16> length[4];
+        for(int i = 0; i < 4; i++) {
+            while(queues[i].size() < 4) queues[i].push_back(64 + rand() % 1437);
+            nonempty[i] = true;
+            length[i] = queues[i].front();
+        }
+        bool ready = rand() % 4 != 0;
+        int q = s.schedule(nonempty, length, ready);
+        assert(ready || q == -1);
+        if(q >= 0) {
+            bytes[q] += queues[q].front();
+            queues[q].pop_front();
+        }
+    }
+}
+
+// Check that bytes are shared in the ratio 1:2:3:4, within 2%.
+void check_shares(const long bytes[4]) {
+    long total = bytes[0] + bytes[1] + bytes[2] + bytes[3];
+    for(int i = 0; i < 4; i++) {
+        double share = double(bytes[i]) / total;
+        std::cout << " " << share;
+        assert(share > (i + 1) / 10.0 - 0.02 && share < (i + 1) / 10.0 + 0.02);
+    }
+    std::cout << "\n";
+}
+
+int main() {
+    SchedulerT s;
+    long bytes[4];
+
+    // Strict priority always sends from the highest nonempty queue.
+    for(int k = 0; k < 1000; k++) {
+        bool nonempty[4];
+        ap_uint<16> length[4];
+        int highest = -1;
+        for(int i = 0; i < 4; i++) {
+            nonempty[i] = rand() % 2;
+            length[i] = 64;
+            if(nonempty[i]) highest = i;
+        }
+        assert(s.schedule(nonempty, length, true) == highest);
+    }
+
+    s.set_mode(hls::DEFICIT_ROUND_ROBIN);
+    for(int i = 0; i < 4; i++) s.set_quantum(i, 1500 * (i + 1));
+    run(s, bytes, 200000);
+    std::cout << "DRR shares:";
+    check_shares(bytes);
+
+    s.set_mode(hls::WEIGHTED_FAIR_QUEUEING);
+    for(int i = 0; i < 4; i++) s.set_cost(i, 12 / (i + 1));
+    run(s, bytes, 200000);
+    std::cout << "WFQ shares:";
+    check_shares(bytes);
+
+    // A queue which receives less than its share is not delayed.
+    {
+        int waiting = 0;
+        for(int k = 0; k < 100000; k++) {
+            if(k % 10 == 0) waiting++;
+            bool nonempty[4] = {waiting > 0, true, true, true};
+            ap_uint<16> length[4] = {100, 1000, 1000, 1000};
+            int q = s.schedule(nonempty, length, true);
+            if(q == 0) waiting--;
+            assert(waiting <= 1);
+        }
+    }
+
+    // A queue which is not eligible keeps its place.
+    s.set_mode(hls::DEFICIT_ROUND_ROBIN);
+    for(int i = 0; i < 4; i++) s.set_quantum(i, 1500);
+    for(int k = 0; k < 100; k++) {
+        bool nonempty[4] = {true, true, true, true};
+        bool eligible[4] = {true, k % 2 == 0, true, true};
+        ap_uint<16> length[4] = {1000, 1000, 1000, 1000};
+        int q = s.schedule(nonempty, eligible, length, true);
+        assert(q >= 0 && eligible[q]);
+    }
+
+    // Drops come from the lowest queue for strict priority, and from the
+    // longest queue otherwise.
+    bool nonempty[4] = {false, true, true, true};
+    int queued[4] = {0, 100, 3000, 200};
+    assert(s.victim(nonempty, queued) == 2);
+    s.set_mode(hls::STRICT_PRIORITY);
+    assert(s.victim(nonempty, queued) == 1);
+    // A packet arriving for a lower queue is dropped itself.
+    assert(s.victim(nonempty, queued, 0) == -1);
+    assert(s.victim(nonempty, queued, 1) == 1);
+    assert(s.victim(nonempty, queued, 3) == 1);
+    nonempty[1] = nonempty[2] = nonempty[3] = false;
+    assert(s.victim(nonempty, queued) == -1);
+
+    std::cout << "Scheduler tests passed\n";
+}
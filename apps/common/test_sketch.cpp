@@ -0,0 +1,65 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <map>
+#include <iostream>
+#include "sketch.h"
+
+typedef hls::heavy_hitter<8, 4, 1024, ap_uint<32>, ap_uint<32> > HeavyHitterT;
+
+// Count the bytes sent by each source and report the top talkers.
+void top(ap_uint<32> sources[256], ap_uint<16> lengths[256],
+         hls::stream<HeavyHitterT::RecordT> &report) {
+    static HeavyHitterT hh;
+    for(int i = 0; i < 256; i++) {
+#pragma HLS pipeline II=1
+        hh.update(sources[i], lengths[i]);
+    }
+    hh.report(report, 1024);
+}
+
+int main(int argv, char * argc[]) {
+    const int HEAVY = 4;
+    std::map<ap_uint<32>, unsigned> counts;
+    static HeavyHitterT hh;
+    for(int i = 0; i < 100000; i++) {
+        // Every fourth packet comes from one of a few heavy sources.
+        ap_uint<32> key = (i % 4 == 0) ? ap_uint<32>(rand() % HEAVY) : ap_uint<32>(rand());
+        ap_uint<32> inc = 1 + rand() % 4;
+        counts[key] += inc;
+        ap_uint<32> estimate = hh.update(key, inc);
+        assert(estimate >= counts[key]);
+    }
+    // The sketch never underestimates.
+    for(std::map<ap_uint<32>, unsigned>::iterator i = counts.begin(); i != counts.end(); i++) {
+        ap_uint<32> estimate = hh.sketch.query(i->first);
+        assert(estimate >= i->second);
+    }
+
+    // The heavy sources are reported.
+    hls::stream<HeavyHitterT::RecordT> report;
+    int n = hh.report(report, 10000);
+    std::cout << n << " heavy hitters\n";
+    assert(n == HEAVY);
+    bool last = false;
+    while(!last) {
+        HeavyHitterT::RecordT r = report.read();
+        std::cout << r.key << " " << r.value << " (" << counts[r.key] << ")\n";
+        assert(r.key < HEAVY);
+        last = r.last;
+    }
+}
@@ -223,6 +223,179 @@ void top(hls::stream<CAM_T::LookupRequest>	&LookupReq,
     CAM_T::top(LookupReq, LookupResp, UpdateReq, UpdateResp);
 }
 
+// Check that updates are not starved by a sustained lookup load
+// from two sources, and that lookups are shared according to the weights.
+void check_arbitration() {
+    std::cout << "Checking arbitration...\n";
+    hls::stream<CAM_T::LookupRequest> req[2];
+    hls::stream<CAM_T::LookupReply> resp[2];
+    const ap_uint<8> weights[2] = {3, 1};
+    const int UPDATES = 4;
+    const int CYCLES = 64;
+    for(int i = 0; i < CYCLES; i++) {
+        for(int s = 0; s < 2; s++) {
+            CAM_T::LookupRequest r(i);
+            r.source = s;
+            req[s].write(r);
+        }
+    }
+    for(int i = 0; i < UPDATES; i++) {
+        send_insert(1000+i, i);
+    }
+    int updates = 0;
+    int lookups[2] = {0, 0};
+    for(int i = 0; i < CYCLES; i++) {
+        CAM_T::arbitrated_top<2>(req, resp, UpdateReq, UpdateResp, weights, 4, 2);
+        while(!UpdateResp.empty()) {
+            UpdateResp.read();
+            updates++;
+        }
+        for(int s = 0; s < 2; s++) {
+            while(!resp[s].empty()) {
+                CAM_T::LookupReply r = resp[s].read();
+                assert(r.source == s);
+                lookups[s]++;
+            }
+        }
+    }
+    std::cout << "lookups " << lookups[0] << " " << lookups[1] << "\n";
+    assert(updates == UPDATES);
+    assert(lookups[0] + lookups[1] + UPDATES == CYCLES);
+    assert(lookups[0] >= 2*lookups[1]);
+    for(int s = 0; s < 2; s++) {
+        while(!req[s].empty()) req[s].read();
+    }
+    for(int i = 0; i < UPDATES; i++) {
+        send_remove(1000+i);
+    }
+    for(int i = 0; i < 16*UPDATES; i++) {
+        top(LookupReq, LookupResp, UpdateReq, UpdateResp);
+    }
+    for(int i = 0; i < UPDATES; i++) {
+        receive_update();
+    }
+}
+
+// Check that an update_batch of zero grants one update at a time.
+void check_unbatched() {
+    std::cout << "Checking unbatched updates...\n";
+    hls::stream<CAM_T::LookupRequest> req[2];
+    hls::stream<CAM_T::LookupReply> resp[2];
+    const ap_uint<8> weights[2] = {1, 1};
+    const int UPDATES = 4;
+    const int CYCLES = 32;
+    for(int i = 0; i < CYCLES; i++) {
+        req[0].write(CAM_T::LookupRequest(i));
+    }
+    for(int i = 0; i < UPDATES; i++) {
+        send_insert(2000+i, i);
+    }
+    int updates = 0;
+    bool last_update = false;
+    for(int i = 0; i < CYCLES; i++) {
+        CAM_T::arbitrated_top<2>(req, resp, UpdateReq, UpdateResp, weights, 2, 0);
+        bool update = !UpdateResp.empty();
+        while(!UpdateResp.empty()) {
+            UpdateResp.read();
+            updates++;
+        }
+        assert(!(update && last_update));
+        last_update = update;
+        while(!resp[0].empty()) resp[0].read();
+    }
+    assert(updates == UPDATES);
+    while(!req[0].empty()) req[0].read();
+    for(int i = 0; i < UPDATES; i++) {
+        send_remove(2000+i);
+    }
+    for(int i = 0; i < 16*UPDATES; i++) {
+        top(LookupReq, LookupResp, UpdateReq, UpdateResp);
+    }
+    for(int i = 0; i < UPDATES; i++) {
+        receive_update();
+    }
+}
+
+// Check that two tables can migrate entries independently, concurrently
+// with lookups.
+void check_concurrent_migration() {
+    std::cout << "Checking concurrent migration...\n";
+    typedef hls::algorithmic_cam<64, 4, ap_uint<32>, ap_uint<8> > TableT;
+    TableT tables[2];
+    std::map<ap_uint<32>, ap_uint<8> > maps[2];
+    for(int i = 0; i < 400; i++) {
+        for(int t = 0; t < 2; t++) {
+            if(i < 256 && (i % 8) == 0 && tables[t].canInsert()) {
+                ap_uint<32> k = rand();
+                ap_uint<8> v = rand();
+                assert(tables[t].insert(k, v));
+                maps[t][k] = v;
+            }
+            for(std::map<ap_uint<32>, ap_uint<8> >::iterator j = maps[t].begin(); j != maps[t].end(); j++) {
+                ap_uint<8> v;
+                assert(tables[t].get(j->first, v) && v == j->second);
+            }
+            tables[t].migrate();
+        }
+    }
+    for(int t = 0; t < 2; t++) {
+        for(std::map<ap_uint<32>, ap_uint<8> >::iterator j = maps[t].begin(); j != maps[t].end(); j++) {
+            ap_uint<8> v;
+            assert(!tables[1-t].get(j->first, v));
+        }
+    }
+}
+
+// Select entries with odd keys.
+struct odd_key {
+    bool operator()(const ap_uint<keysize> &key, const ap_uint<valuesize> &value) {
+        return key[0];
+    }
+};
+
+// Check that the table can be loaded and dumped in bulk, and
+// cleared by predicate.
+template <typename MapT>
+void check_bulk(MapT &mymap) {
+    std::cout << "Checking bulk load...\n";
+    const int ENTRIES = N/2;
+    hls::stream<CAM_T::Record> LoadReq, DumpResp;
+    hls::stream<ap_uint<32> > LoadResp, DumpCount;
+    for(int i = 0; i < ENTRIES; i++) {
+        ap_uint<32> k = rand();
+        ap_uint<8> v = rand();
+        mymap[k] = v;
+        LoadReq.write(CAM_T::Record(k, v, i == ENTRIES-1));
+    }
+    CAM_T::load(LoadReq, LoadResp);
+    assert(LoadResp.read() == 0);
+
+    CAM_T::dump(DumpResp, DumpCount);
+    assert(DumpCount.read() == mymap.size());
+    MapT dumped;
+    bool last = false;
+    while(!last) {
+        CAM_T::Record r = DumpResp.read();
+        assert(dumped.count(r.key) == 0);
+        dumped[r.key] = r.value;
+        last = r.last;
+    }
+    assert(DumpResp.empty());
+    assert(dumped == mymap);
+
+    odd_key pred;
+    int removed = CAM_T::clear_if(pred);
+    for(typename MapT::iterator i = mymap.begin(); i != mymap.end();) {
+        if(pred(i->first, i->second)) {
+            mymap.erase(i++);
+            removed--;
+        } else {
+            i++;
+        }
+    }
+    assert(removed == 0);
+}
+
 template <typename MapT>
 void check_consistency(MapT mymap) {
     std::cout << "Checking consistency...\n";
@@ -271,6 +444,10 @@ int main(int argv, char * argc[]) {
     }
     //    std::cout << mycam << "\n";
     check_consistency(mymap);
+    check_arbitration();
+    check_unbatched();
+    check_consistency(mymap);
+    check_concurrent_migration();
 
     for(MapT::iterator i = mymap.begin(); i != mymap.end(); i++) {
         ap_uint<32> k = i->first;
@@ -371,4 +548,8 @@ int main(int argv, char * argc[]) {
         bool b = receive_lookup(v);
         assert(!b); // Should have been removed
     }
+
+    mymap.clear();
+    check_bulk(mymap);
+    check_consistency(mymap);
 }
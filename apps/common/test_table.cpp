@@ -0,0 +1,184 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <iostream>
+#include "table.h"
+
+// Packet metadata which is updated by the actions.
+struct Metadata {
+    ap_uint<4> port;
+    ap_uint<48> nexthop;
+    bool drop;
+    Metadata() : port(0), nexthop(0), drop(false) {}
+};
+
+struct Forward {
+    ap_uint<4> port;
+    ap_uint<48> nexthop;
+};
+
+struct set_port {
+    static void apply(const Forward &data, Metadata &meta) {
+        meta.port = data.port;
+    }
+};
+struct set_nexthop {
+    static void apply(const Forward &data, Metadata &meta) {
+        meta.port = data.port;
+        meta.nexthop = data.nexthop;
+    }
+};
+struct drop {
+    static void apply(const Forward &data, Metadata &meta) {
+        meta.drop = true;
+    }
+};
+
+enum { SET_PORT, SET_NEXTHOP, DROP, NOP };
+
+typedef hls::match_action_table<hls::lpm_match<16>, ap_uint<32>, Forward,
+                                set_port, set_nexthop, drop, hls::no_action> RouteTableT;
+typedef hls::match_action_table<hls::ternary_match<8>, ap_uint<16>, Forward,
+                                set_port, set_nexthop, drop, hls::no_action> AclTableT;
+typedef hls::match_action_table<hls::range_match<8>, ap_uint<16>, Forward,
+                                set_port, set_nexthop, drop, hls::no_action> ClassTableT;
+typedef hls::match_action_table<hls::exact_match<8>, ap_uint<48>, Forward,
+                                set_port, set_nexthop, drop, hls::no_action> MacTableT;
+typedef hls::match_action_table<hls::hash_match<64, 2>, ap_uint<48>, Forward,
+                                set_port, set_nexthop, drop, hls::no_action> BigMacTableT;
+
+Forward fwd(int port, ap_uint<48> nexthop = 0) {
+    Forward f;
+    f.port = port;
+    f.nexthop = nexthop;
+    return f;
+}
+
+// Route on the destination address, then apply an acl on the destination port.
+void top(ap_uint<32> dstIP, ap_uint<16> dstPort, Metadata &meta) {
+#pragma HLS pipeline II=1
+    static RouteTableT routes;
+    static AclTableT acl;
+    Metadata m;
+    routes.apply(dstIP, m);
+    acl.apply(dstPort, m);
+    meta = m;
+}
+
+Metadata route(RouteTableT &routes, AclTableT &acl, ap_uint<32> dstIP, ap_uint<16> dstPort) {
+    Metadata m;
+    routes.apply(dstIP, m);
+    acl.apply(dstPort, m);
+    return m;
+}
+
+int main(int argv, char * argc[]) {
+    static RouteTableT routes;
+    static AclTableT acl;
+    routes.set_default(DROP, Forward());
+    assert(routes.add(0x0a000000, 8, SET_PORT, fwd(1)));
+    assert(routes.add(0x0a010000, 16, SET_NEXTHOP, fwd(2, 0x112233445566)));
+    assert(routes.add(0x0a010200, 24, SET_PORT, fwd(3)));
+    acl.set_default(NOP, Forward());
+    assert(acl.add(0x0000, 0xFF00, 1, SET_PORT, fwd(7)));   // Ports 0-255 to port 7.
+    assert(acl.add(0x0016, 0xFFFF, 2, DROP, Forward()));    // Drop port 22.
+
+    Metadata m;
+    m = route(routes, acl, 0x0b000001, 1000);
+    assert(m.drop);
+    m = route(routes, acl, 0x0a7f0001, 1000);
+    assert(!m.drop && m.port == 1);
+    m = route(routes, acl, 0x0a01ff01, 1000);
+    assert(!m.drop && m.port == 2 && m.nexthop == 0x112233445566);
+    m = route(routes, acl, 0x0a010203, 1000);
+    assert(!m.drop && m.port == 3 && m.nexthop == 0);
+    m = route(routes, acl, 0x0a010203, 80);
+    assert(!m.drop && m.port == 7);
+    m = route(routes, acl, 0x0a010203, 22);
+    assert(m.drop);
+
+    // Replacing and removing entries.
+    assert(routes.add(0x0a010200, 24, SET_PORT, fwd(4)));
+    m = route(routes, acl, 0x0a010203, 1000);
+    assert(m.port == 4);
+    assert(routes.remove(0x0a010200, 24));
+    assert(!routes.remove(0x0a010200, 24));
+    m = route(routes, acl, 0x0a010203, 1000);
+    assert(m.port == 2);
+
+    // Exact match tables.
+    static MacTableT macs;
+    static BigMacTableT bigmacs;
+    macs.set_default(DROP, Forward());
+    bigmacs.set_default(DROP, Forward());
+    for(int i = 0; i < 8; i++) {
+        assert(macs.add(0x100 + i, SET_PORT, fwd(i)));
+        assert(bigmacs.add(0x100 + i, SET_PORT, fwd(i)));
+        for(int j = 0; j < 8; j++) bigmacs.migrate();
+    }
+    for(int i = 0; i < 8; i++) {
+        Metadata m1, m2;
+        assert(macs.apply(0x100 + i, m1));
+        assert(bigmacs.apply(0x100 + i, m2));
+        assert(m1.port == i && m2.port == i);
+    }
+    Metadata miss;
+    assert(!macs.apply(0x200, miss));
+    assert(miss.drop);
+
+    // Range match tables.
+    static ClassTableT classes;
+    classes.set_default(NOP, Forward());
+    assert(classes.add(1024, 65535, 0, SET_PORT, fwd(5)));  // Unprivileged ports.
+    assert(classes.add(5000, 5999, 1, SET_PORT, fwd(6)));   // A higher priority subrange.
+    assert(classes.add(0, 1023, 0, DROP, Forward()));
+    for(int port = 0; port < 65536; port += 7) {
+        Metadata c;
+        assert(classes.apply(port, c));
+        if(port < 1024) {
+            assert(c.drop);
+        } else {
+            assert(!c.drop && c.port == ((port >= 5000 && port < 6000) ? 6 : 5));
+        }
+    }
+    assert(classes.remove(0, 1023));
+    Metadata c;
+    assert(!classes.apply(80, c));
+    assert(!c.drop);
+
+    // A miss in a table without a default action does nothing.
+    static MacTableT nodefault;
+    Metadata n;
+    n.port = 3;
+    assert(!nodefault.apply(0x100, n));
+    assert(n.port == 3 && !n.drop);
+
+    // Packet length buckets using a range_cam directly.
+    hls::range_cam<4, ap_uint<16>, ap_uint<2> > buckets;
+    assert(buckets.insert(0, 127, 0));
+    assert(buckets.insert(128, 511, 1));
+    assert(buckets.insert(512, 1517, 2));
+    assert(buckets.insert(1518, 9000, 3));
+    assert(!buckets.canInsert());
+    assert(!buckets.insert(9001, 9999, 3));
+    for(int length = 0; length <= 9000; length++) {
+        ap_uint<2> b;
+        assert(buckets.get(length, b));
+        assert(b == (length < 128 ? 0 : length < 512 ? 1 : length < 1518 ? 2 : 3));
+    }
+    std::cout << "PASS\n";
+}
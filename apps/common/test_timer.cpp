@@ -0,0 +1,116 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <map>
+#include <iostream>
+#include "timer.h"
+
+typedef hls::timer_wheel<16, 3, 64> TimerWheelT;
+
+// Start a burst of timers and report those which expire.
+void top(ap_uint<6> ids[64], ap_uint<12> delays[64], bool ticks[64],
+         hls::stream<ap_uint<6> > &expired) {
+    static TimerWheelT timers;
+    for(int i = 0; i < 64; i++) {
+#pragma HLS pipeline
+        timers.schedule(ids[i], delays[i]);
+        int id;
+        if(timers.expire(ticks[i], id)) expired.write(id);
+    }
+}
+
+// Check that each timer expires exactly once at the right time, unless it is cancelled.
+void check_wheel() {
+    static TimerWheelT timers;
+    std::map<int, long> expected; // id -> expiry time
+    long time = 0; // The time of the wheel, without wrapping.
+    int expirations = 0;
+    int maxlag = 0;
+    long ticks = 0;
+    for(int k = 0; k < 200000; k++) {
+        int op = rand() % 16;
+        int id = rand() % 64;
+        if(op == 0) {
+            int delay = 1 + ((rand() % 2) ? rand() % 32 : rand() % TimerWheelT::MAXDELAY);
+            timers.schedule(id, delay);
+            expected[id] = time + delay;
+        } else if(op == 1) {
+            timers.cancel(id);
+            expected.erase(id);
+        }
+        assert(timers.is_scheduled(id) == (expected.count(id) == 1));
+        bool tick = rand() % 4 == 0;
+        if(tick) ticks++;
+        TimerWheelT::TimeT before = timers.now;
+        int e;
+        bool b = timers.expire(tick, e);
+        if(timers.now != before) time++;
+        assert(ticks - time >= 0);
+        if(ticks - time > maxlag) maxlag = ticks - time;
+        if(b) {
+            assert(expected.count(e) == 1);
+            assert(expected[e] == time);
+            expected.erase(e);
+            expirations++;
+        }
+        // Nothing is overdue.
+        for(std::map<int, long>::iterator i = expected.begin(); i != expected.end(); i++) {
+            assert(i->second >= time);
+        }
+    }
+    std::cout << expirations << " expirations, maximum lag " << maxlag << " ticks\n";
+}
+
+// Check that messages are resent after the timeout, with exponential backoff.
+void check_message_buffer() {
+    static hls::TimedMessageBuffer<int, 16, 16, 2> buffer;
+    buffer.set_timeout(10, true);
+    int id = buffer.put(42);
+    assert(id >= 0);
+    int resends[4];
+    int count = 0;
+    for(int t = 0; t < 200 && count < 4; t++) {
+        for(int i = 0; i < 4; i++) {
+            buffer.tick(i == 0);
+        }
+        int rid;
+        int v = buffer.get(rid);
+        if(rid >= 0) {
+            assert(rid == id && v == 42);
+            resends[count++] = t;
+        }
+    }
+    assert(count == 4);
+    std::cout << "resent at " << resends[0] << " " << resends[1] << " " << resends[2] << " " << resends[3] << "\n";
+    assert(resends[0] == 9);
+    assert(resends[1] - resends[0] == 10);
+    assert(resends[2] - resends[1] == 20);
+    assert(resends[3] - resends[2] == 40);
+    // Acknowledged messages are not resent.
+    buffer.clear(id);
+    for(int t = 0; t < 200; t++) {
+        buffer.tick(true);
+        int rid;
+        buffer.get(rid);
+        assert(rid == -1);
+    }
+}
+
+int main(int argv, char * argc[]) {
+    check_wheel();
+    check_message_buffer();
+}
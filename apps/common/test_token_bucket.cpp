@@ -0,0 +1,74 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <iostream>
+#include "token_bucket.h"
+
+typedef hls::token_buckets<4> BucketsT;
+
+// Police a stream of packets, passing those which conform.
+void top(ap_uint<2> queues[64], ap_uint<16> lengths[64], bool conforms[64]) {
+    static BucketsT buckets;
+    for(int i = 0; i < 64; i++) {
+#pragma HLS pipeline II=1
+        conforms[i] = buckets.consume(queues[i], lengths[i]);
+        buckets.tick();
+    }
+}
+
+int main() {
+    BucketsT buckets;
+
+    // Disabled buckets pass everything.
+    for(int k = 0; k < 100; k++) {
+        assert(buckets.consume(k % 4, 1500));
+        buckets.tick();
+    }
+
+    // Bucket i passes (i+1)/8 bytes per tick, with a burst of 2000 bytes.
+    for(int i = 0; i < 4; i++) {
+        buckets.set_rate(i, (i + 1) << (16 - 3));
+        buckets.set_burst(i, 2000);
+    }
+    // The initial burst passes immediately.
+    assert(buckets.consume(0, 1500));
+    assert(!buckets.consume(0, 1500));
+    assert(buckets.consume(0, 500));
+    assert(!buckets.consume(0, 1));
+
+    // Offer more traffic than the rate, and check the conforming rate.
+    const int TICKS = 400000;
+    long passed[4] = {};
+    for(int k = 0; k < TICKS; k++) {
+        int q = k % 4;
+        int length = 64 + rand() % 1437;
+        if(buckets.consume(q, length)) passed[q] += length;
+        buckets.tick();
+    }
+    for(int i = 0; i < 4; i++) {
+        long expected = long(TICKS) * (i + 1) / 8;
+        std::cout << "Bucket " << i << " passed " << passed[i] << " of " << expected << " bytes\n";
+        assert(passed[i] <= expected + 2000 && passed[i] > expected * 95 / 100);
+    }
+
+    // Buckets never fill beyond their burst size.
+    for(int k = 0; k < 100000; k++) buckets.tick();
+    assert(buckets.consume(3, 2000));
+    assert(!buckets.consume(3, 1));
+
+    std::cout << "Token bucket tests passed\n";
+}
@@ -0,0 +1,255 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "allocator.h"
+
+namespace hls {
+
+    // A hierarchical timer wheel for N timers, identified by ids 0 to N-1.
+    // Level l has Slots slots, each covering Slots^l ticks, so delays of up to
+    // Slots^Levels-1 ticks can be scheduled.  The timers in each slot are kept
+    // in a doubly linked list, so schedule() and cancel() take a fixed number
+    // of operations.  expire() is intended to be called regularly.  Each call
+    // either advances the time of the wheel by one tick, or processes one timer
+    // from the slots reached by the last tick: either expiring it or moving it
+    // to a lower level.  Ticks which arrive while timers are being processed
+    // are counted and applied later.  Moving a timer unlinks and relinks it,
+    // which takes up to three accesses to next and four to prev, so a call
+    // to expire() or schedule() takes more than one cycle with dual-port
+    // memories.
+    // Slots is power of 2.
+    template <int Slots, int Levels, int N>
+    class timer_wheel {
+    public:
+        const static int SLOTBITS = BitWidth<Slots-1>::Value;
+        const static int TIMEBITS = SLOTBITS*Levels;
+        const static int LISTS = Slots*Levels;
+        const static int MAXDELAY = (1 << TIMEBITS) - 1;
+        typedef ap_uint<TIMEBITS> TimeT;
+        typedef ap_int<BitWidth<N>::Value+1> IdT;
+        typedef ap_uint<BitWidth<LISTS-1>::Value> ListT;
+
+        // The current time of the wheel.
+        TimeT now;
+        ap_uint<32> pending_ticks;
+        IdT head[LISTS];
+        IdT next[N];
+        IdT prev[N];
+        ListT list[N];
+        TimeT deadline[N];
+        bool scheduled[N];
+        // Levels whose current slot is being processed.
+        ap_uint<Levels> draining;
+
+        timer_wheel() {
+#pragma HLS array_partition variable=head complete
+            clear();
+        }
+        void clear() {
+            for(int i = 0; i < LISTS; i++) {
+#pragma HLS unroll
+                head[i] = -1;
+            }
+            for(int i = 0; i < N; i++) {
+#pragma HLS pipeline II=1
+                scheduled[i] = false;
+            }
+            now = 0;
+            pending_ticks = 0;
+            draining = 0;
+        }
+        // Return the list holding timers at level l with the given time.
+        static ListT slot(int l, const TimeT &t) {
+            return l*Slots + ((t >> (l*SLOTBITS)) & (Slots-1));
+        }
+        // Return the list for a timer which expires at time d, which must not be now.
+        // This is at the level of the most significant digit in which d differs from now.
+        ListT place(const TimeT &d) {
+            TimeT diff = d ^ now;
+            int level = 0;
+            for(int l = 1; l < Levels; l++) {
+#pragma HLS unroll
+                if((diff >> (l*SLOTBITS)) != 0) level = l;
+            }
+            return slot(level, d);
+        }
+        void link(const IdT &id, const ListT &l) {
+            IdT h = head[l];
+            next[id] = h;
+            prev[id] = -1;
+            if(h >= 0) prev[h] = id;
+            head[l] = id;
+            list[id] = l;
+        }
+        void unlink(const IdT &id) {
+            IdT n = next[id];
+            IdT p = prev[id];
+            if(p >= 0) {
+                next[p] = n;
+            } else {
+                head[list[id]] = n;
+            }
+            if(n >= 0) prev[n] = p;
+        }
+        bool is_scheduled(int id) {
+            return scheduled[id];
+        }
+        // Start timer id, which expires delay ticks from now.  If the timer
+        // is already running, then it is restarted.  Delays are limited to
+        // between 1 and MAXDELAY ticks.
+        void schedule(int id, ap_uint<32> delay) {
+            if(scheduled[id]) unlink(id);
+            if(delay < 1) delay = 1;
+            if(delay > MAXDELAY) delay = MAXDELAY;
+            TimeT d = now + delay;
+            deadline[id] = d;
+            scheduled[id] = true;
+            link(id, place(d));
+        }
+        // Stop timer id, if it is running.
+        void cancel(int id) {
+            if(scheduled[id]) unlink(id);
+            scheduled[id] = false;
+        }
+        // Advance the wheel.  If tick is set, then one more tick has elapsed.
+        // Return true if a timer expired, along with its id.
+        bool expire(bool tick, int &id) {
+#pragma HLS pipeline
+            if(tick) pending_ticks++;
+            // Find the lowest level with a timer to process.
+            int level = -1;
+            for(int l = Levels-1; l >= 0; l--) {
+#pragma HLS unroll
+                if(draining[l]) {
+                    if(head[slot(l, now)] >= 0) {
+                        level = l;
+                    } else {
+                        draining[l] = false;
+                    }
+                }
+            }
+            if(level >= 0) {
+                IdT e = head[slot(level, now)];
+                unlink(e);
+                if(deadline[e] == now) {
+                    scheduled[e] = false;
+                    id = e;
+#ifdef DEBUG
+                    std::cout << "Timer " << e << " expired at " << now << "\n";
+#endif
+                    return true;
+                }
+                link(e, place(deadline[e]));
+            } else if(pending_ticks > 0) {
+                pending_ticks--;
+                now++;
+                // The current slot at level l is reached when the lower
+                // digits of the time are zero.
+                for(int l = 0; l < Levels; l++) {
+#pragma HLS unroll
+                    draining[l] = (now & ((TimeT(1) << (l*SLOTBITS)) - 1)) == 0;
+                }
+            }
+            return false;
+        }
+    };
+
+    // A MessageBuffer where each message only becomes eligible for resending
+    // once its retransmission timer expires.  Each time a message is
+    // returned by get(), its timer is restarted, with the timeout doubled
+    // for each previous resend if backoff is enabled.
+    template<typename T, int N, int Slots, int Levels>
+    class TimedMessageBuffer {
+    public:
+        MessageBuffer<T, N> buffer;
+        timer_wheel<Slots, Levels, N> timers;
+        // Messages whose timer has expired.
+        ap_uint<N> ready;
+        ap_uint<4> retries[N];
+        ap_uint<32> timeout;
+        bool backoff;
+        const static int MAXRETRIES = 8;
+
+        TimedMessageBuffer() {
+            ready = 0;
+            timeout = 1;
+            backoff = false;
+        }
+        // Resend each message timeout ticks after it is put, and after each
+        // resend.  If exponential_backoff is set, then the timeout doubles
+        // after each resend.
+        void set_timeout(ap_uint<32> t, bool exponential_backoff) {
+            timeout = t;
+            backoff = exponential_backoff;
+        }
+        bool is_allocated(int id) {
+            return buffer.is_allocated(id);
+        }
+        // Advance the retransmission timers.  This is intended to be called
+        // regularly.  If tick is set, then one more tick has elapsed.
+        void tick(bool tick) {
+            int id;
+            if(timers.expire(tick, id) && buffer.is_allocated(id)) {
+                ready[id] = true;
+            }
+        }
+        // Put a new value t into the buffer.  If this succeeds, then return an id associated with the value in the buffer.
+        // Otherwise return -1.
+        int put(T t) {
+            int id = buffer.put(t);
+            if(id >= 0) {
+                ready[id] = false;
+                retries[id] = 0;
+                timers.schedule(id, timeout);
+            }
+            return id;
+        }
+        // Get a value whose timer has expired from the buffer along with it's id.  If there is no such value,
+        // then the return value is undefined and id is set to -1.
+        T get(int &id) {
+            T t = T();
+            if(ready == 0) {
+                id = -1;
+                return t;
+            }
+            id = ready.reverse().countLeadingZeros();
+            ready[id] = false;
+            ap_uint<4> r = retries[id];
+            ap_uint<32> delay = timeout;
+            if(backoff) delay <<= r;
+            if(r < MAXRETRIES) retries[id] = r + 1;
+            timers.schedule(id, delay);
+            t = buffer.data[id];
+            return t;
+        }
+        void clear() {
+            buffer.clear();
+            timers.clear();
+            ready = 0;
+        }
+        void clear(int id) {
+            timers.cancel(id);
+            ready[id] = false;
+            buffer.clear(id);
+        }
+        int size() {
+            return buffer.size();
+        }
+    };
+}
@@ -0,0 +1,97 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "ap_int.h"
+
+namespace hls {
+
+    // N independent token buckets, for shaping or policing N classes of
+    // traffic.  Each bucket gains rate bytes of tokens in each call to
+    // tick(), up to burst bytes, and a packet conforms if there are at
+    // least as many tokens as bytes in the packet.  The rate has FRACBITS
+    // fractional bits, so that rates of less than one byte per tick can be
+    // represented.  A rate of zero disables the bucket, so that every packet
+    // conforms.  For shaping, the burst should be at least the largest
+    // packet length, otherwise large packets will never conform.
+    template <int N, int FRACBITS = 16>
+    class token_buckets {
+    public:
+        typedef ap_uint<32> RateT;
+        typedef ap_uint<24> BurstT;
+        typedef ap_uint<24+FRACBITS> TokenT;
+
+        TokenT tokens[N];
+        TokenT depth[N];
+        RateT rate[N];
+
+        token_buckets() {
+#pragma HLS array_partition variable=tokens complete
+#pragma HLS array_partition variable=depth complete
+#pragma HLS array_partition variable=rate complete
+            for(int i = 0; i < N; i++) {
+                rate[i] = 0;
+                depth[i] = 0;
+            }
+            clear();
+        }
+        // Fill every bucket.
+        void clear() {
+            for(int i = 0; i < N; i++) {
+#pragma HLS unroll
+                tokens[i] = depth[i];
+            }
+        }
+        // Set the rate of bucket q, in bytes per tick with FRACBITS fractional bits.
+        void set_rate(int q, const RateT &r) {
+            rate[q] = r;
+        }
+        // Set the burst size of bucket q, in bytes, and fill the bucket.
+        void set_burst(int q, const BurstT &burst) {
+            depth[q] = TokenT(burst) << FRACBITS;
+            tokens[q] = depth[q];
+        }
+        bool enabled(int q) {
+            return rate[q] != 0;
+        }
+        // Return true if a packet of length bytes conforms to bucket q.
+        template <typename LengthT>
+        bool conforms(int q, const LengthT &length) {
+            return !enabled(q) || tokens[q] >= (TokenT(length) << FRACBITS);
+        }
+        // Take the tokens for a packet of length bytes from bucket q, if it conforms.
+        // Return true if the packet conforms.
+        template <typename LengthT>
+        bool consume(int q, const LengthT &length) {
+#pragma HLS inline
+            bool b = conforms(q, length);
+            if(b && enabled(q)) tokens[q] -= TokenT(length) << FRACBITS;
+            return b;
+        }
+        // Add rate bytes of tokens to every bucket, up to its burst size.
+        void tick() {
+#pragma HLS inline
+            for(int i = 0; i < N; i++) {
+#pragma HLS unroll
+                TokenT t = tokens[i] + rate[i];
+                if(t > depth[i] || t < tokens[i]) t = depth[i];
+                tokens[i] = t;
+            }
+        }
+    };
+}
@@ -28,6 +28,7 @@ limitations under the License.
 #include "ip.hpp"
 #include "cam.h"
 #include "allocator.h"
+#include "timer.h"
 
 using namespace mqttsn;
 using namespace arp;
@@ -36,7 +37,12 @@ const MACAddressT BROADCAST_MAC	= 0xFFFFFFFFFFFF;	// Broadcast MAC Address
 const IPAddressT BROADCAST_IP =  0xFFFFFFFF;	// Broadcast IP Address
 
 //typedef hls::algorithmic_cam<256, 4, MacLookupKeyT, MacLookupValueT> ArpCacheT;
-typedef hls::cam<4, IPAddressT, MACAddressT> ArpCacheT;
+// Evict the least recently used host, so that the cache keeps learning.
+typedef hls::cam<4, IPAddressT, MACAddressT, hls::lru_replacement> ArpCacheT;
+// Unacknowledged publishes are resent RETRANSMIT_TIMEOUT calls to process_packet()
+// after they were last sent, doubling the timeout after each resend.
+const static int RETRANSMIT_TIMEOUT = 16;
+typedef hls::TimedMessageBuffer<std::pair<ap_uint<16>, float>, 128, 16, 2> MessageBufferT;
 
 static STATS stats;
 static bool verbose;
@@ -64,7 +70,7 @@ void package_ethernet_frame(ap_uint<48> macAddress, ap_uint<32> ipAddress, ipv4_
         destMac = BROADCAST_MAC;
     } else {
         IPAddressT destIP2 = (unsigned int)destIP;
-        hit = arpcache.get(destIP2, destMac);
+        hit = arpcache.get(destIP2, destMac, true);
     }
     // std::cout << destIP << " -> " << destMac << "\n";
 
@@ -198,7 +204,7 @@ void test_source(int i, ap_uint<48> macAddress, ap_uint<32> ipAddress,
 
 
 void handle_ethernet_frame(ap_uint<48> macAddress, ap_uint<32> ipAddress, ap_uint<32> *buf, int len, ArpCacheT &arpcache,
-                           MessageBuffer<std::pair<ap_uint<16>, float>, 128 > &buffer) {
+                           MessageBufferT &buffer) {
 #pragma HLS inline all recursive
     Packet p;
     header<Packet, 40> ih(p);
@@ -431,7 +437,7 @@ void process_packet(bool b, ap_uint<48> macAddress, ap_uint<32> ipAddress, ap_ui
                     int count, int size, ap_uint<32> outBuf[4096], int *outLen, bool reset, bool _verbose, STATS &_stats) {
 #pragma HLS inline
     static ArpCacheT arpcache;
-    static MessageBuffer<std::pair<ap_uint<16>, float>, 128 > buffer;
+    static MessageBufferT buffer;
 
     verbose=_verbose;
     if(reset) {
@@ -447,6 +453,8 @@ void process_packet(bool b, ap_uint<48> macAddress, ap_uint<32> ipAddress, ap_ui
         arpcache.clear();
         buffer.clear();
     }
+    buffer.set_timeout(RETRANSMIT_TIMEOUT, true);
+    buffer.tick(true);
     *outLen = 0;
     if(b) {
         stats.packets_received++;
@@ -482,7 +490,8 @@ void process_packet(bool b, ap_uint<48> macAddress, ap_uint<32> ipAddress, ap_ui
     if(!validMessage) {
 #pragma HLS inline all recursive
         // If we don't have a valid message, or we were unable to put it into
-        // the message buffer, then grab a message from the buffer and resend it.
+        // the message buffer, then grab a message whose retransmission timer
+        // has expired from the buffer and resend it.
         std::tie(topicID, message) = buffer.get(messageID);
         if(messageID >= 0) {
             validMessage = true;
@@ -163,7 +163,7 @@ int main(int argc, char* argv[])
     for(int i = 0; i < 20; i++) {
         p.set<1>(i,i);
     }
-    typedef hls::cam<4, MacLookupKeyT, MacLookupValueT> ArpCacheT;
+    typedef hls::cam<4, MacLookupKeyT, MacLookupValueT, hls::lru_replacement> ArpCacheT;
     ArpCacheT arpcache;
     package_ethernet_frame(macAddress, ipAddress, ih, outBuf, &outLen, arpcache);
     hexdump_ethernet_frame<4>(outBuf, outLen);
@@ -60,7 +60,7 @@ int main(int argc, char* argv[])
         p.set<1>(i,i);
     }
     p.extend(20);
-    typedef hls::cam<4, IPAddressT, MACAddressT> ArpCacheT;
+    typedef hls::cam<4, IPAddressT, MACAddressT, hls::lru_replacement> ArpCacheT;
     ArpCacheT arpcache;
     package_ethernet_frame(macAddress, ipAddress, ih, outBuf, outLen, arpcache);
     hexdump_ethernet_frame<4>(outBuf, outLen);
@@ -24,7 +24,10 @@ limitations under the License.
 
 #include "app.h"
 #include "ip.hpp"
-//#include "allocator.h"
+#include "allocator.h"
+#include "scheduler.h"
+#include "token_bucket.h"
+#include "red.h"
 //#include "eth_interface.h"
 #include "hls_math.h"
 #include <tuple>
@@ -33,205 +36,324 @@ limitations under the License.
 bool TEST_generate_output = true;
 
 /** This process supports several independent operations:
-* "ingress": (input_length, diffserv) -> buffer_id
+* "ingress": (input_length, tos) -> (buffer_id, ecn_mark)
 * "egress_free": completed ->
 * "egress_allocate": -> (output, outputLength)
 *
 * When an "ingress" action occurs, the length is stored internally.
 * This length will be returned with the next egress_allocate action
 * with output == buffer_id
+*
+* "control": control -> configures the egress scheduler
+*
+* Packets are sent from the queues in the order chosen by an hls::scheduler,
+* using strict priority, deficit round robin or weighted fair queueing.
+* Each category can be shaped on egress by a token bucket, so that a packet
+* is only sent when its category has enough tokens for its length.  Each
+* category can also be policed on ingress by a token bucket, where packets
+* which are out of profile are either moved to another category or dropped.
+* Dropped packets are given a buffer_id of -1.
+*
+* Each category can also use random early detection, dropping arriving
+* packets with a probability that depends on the average number of bytes
+* in the queue.  In ECN mode, packets which are ECN-capable are instead
+* marked with congestion experienced by setting ecn_mark.
+*
+* Each category is a queue implemented as a linked list of buffers,
+* so the storage required is proportional to BUFFERCOUNT rather than
+* CATEGORYCOUNT*BUFFERCOUNT.  The head of each queue is held in registers,
+* and link[id] holds the entry which follows buffer id in its queue.
+* As a result, an enqueue writes link once and a dequeue reads link once,
+* and both can occur in every call.  Free buffer ids are kept in a
+* FifoAllocator, which reads or writes its memory once per call, so the
+* whole function pipelines at II=1.  The token buckets count one tick per
+* call, so their rates are in bytes per cycle.
 */
+struct queue_entry {
+    bufferIDT id;
+    short length;
+};
+
 void priority_queue_manager(hls::stream<short> &input_length_stream, // input
-                            hls::stream<ap_uint<6> > &diffserv_stream, // input
+                            hls::stream<ap_uint<8> > &tos_stream, // input
                             hls::stream<bufferIDT> &buffer_id_stream, // output
+                            hls::stream<bool> &ecn_mark_stream, // output
                             hls::stream<bufferIDT> &completed, // input
+                            hls::stream<tm_control> &control, // input
                             hls::stream<bufferIDT> &output,    // output
                             hls::stream<short> &outputLength    // output
                             ) {
 #pragma HLS interface port=return ap_ctrl_none
 #pragma HLS interface port=input_length_stream axis
-#pragma HLS interface port=diffserv_stream axis
+#pragma HLS interface port=tos_stream axis
 #pragma HLS interface port=buffer_id_stream axis
+#pragma HLS interface port=ecn_mark_stream axis
 #pragma HLS interface port=completed axis
+#pragma HLS interface port=control axis
 #pragma HLS interface port=output axis
 #pragma HLS interface port=outputLength axis
 
 #pragma HLS stream variable=output depth=32
 #pragma HLS stream variable=outputLength depth=32
 #pragma HLS inline all recursive
-#pragma HLS pipeline II=4
-    static orderT last_written = 0; // Record the order that packets arrive.
-    static orderT last_read = -1; // Record the order that packets leave.
-
+#pragma HLS pipeline II=1
     // Together these implement a priority-queue structure.
-    static std::pair<orderT, bufferIDT> id_by_category[CATEGORYCOUNT][BUFFERCOUNT];
-    static short length[BUFFERCOUNT] = {};
-    static indexT read_index_by_category[CATEGORYCOUNT] = {};
-    static indexT write_index_by_category[CATEGORYCOUNT] = {};
-#pragma HLS array_partition variable=read_index_by_category complete
-#pragma HLS array_partition variable=write_index_by_category complete
-#pragma HLS array_partition variable=id_by_category complete dim=1
-
-    // The category with the oldest packet.  This is the category
-    // that we can read a packet from.
-    int read_category = -1;
-    //indexT read_index;
-    // The id of the buffer for the oldest packet.
-    bufferIDT read_id;
-    // The length of the oldest packet.
-    short read_length = 0;
-
-    // Identify which categories are empty.
-    bool empty[CATEGORYCOUNT];
-    for(int i = 0; i < CATEGORYCOUNT; i++) {
-#pragma HLS unroll
-        empty[i] = read_index_by_category[i] == write_index_by_category[i];
-    }
+    static queue_entry head[CATEGORYCOUNT];
+    static bufferIDT tail[CATEGORYCOUNT];
+    static bool nonempty[CATEGORYCOUNT] = {};
+    static queue_entry link[BUFFERCOUNT];
+    // The last LINK_FORWARD entries written to link, newest first, so that
+    // they can be read while the writes are still in flight.
+    const int LINK_FORWARD = 2;
+    static bufferIDT last_link_id[LINK_FORWARD] = {-1, -1};
+    static queue_entry last_link[LINK_FORWARD];
+    // The number of bytes in each queue.
+    static ap_uint<32> queued_bytes[CATEGORYCOUNT] = {};
+    static hls::scheduler<CATEGORYCOUNT> egress_scheduler;
+    static hls::token_buckets<CATEGORYCOUNT> shapers;
+    static hls::token_buckets<CATEGORYCOUNT> policers;
+    // The category that out-of-profile packets in each category are moved to, if mark is set.
+    static ap_uint<BitWidth<CATEGORYCOUNT>::Value> out_of_profile_category[CATEGORYCOUNT] = {};
+    static bool out_of_profile_mark[CATEGORYCOUNT] = {};
+#pragma HLS array_partition variable=out_of_profile_category complete
+#pragma HLS array_partition variable=out_of_profile_mark complete
+    static hls::red<CATEGORYCOUNT> aqm;
+    static bool ecn_enabled[CATEGORYCOUNT] = {};
+#pragma HLS array_partition variable=ecn_enabled complete
+#pragma HLS array_partition variable=head complete
+#pragma HLS array_partition variable=tail complete
+#pragma HLS array_partition variable=nonempty complete
+#pragma HLS array_partition variable=queued_bytes complete
+#pragma HLS array_partition variable=last_link_id complete
+#pragma HLS array_partition variable=last_link complete
+#pragma HLS data_pack variable=link
+#pragma HLS dependence variable=link inter false
 
 #ifndef __SYNTHESIS__
     std::cout << "empty@";
     for(int i = 0; i < CATEGORYCOUNT; i++) {
-        std::cout << " " << (empty[i] ? "Y":"N");
+        std::cout << " " << (nonempty[i] ? "N":"Y");
     }
     std::cout << "\n";
 #endif
 
-    // Find the category with the oldest packet.
-    // Set read_category, read_id, and read_length.
-    int youngest_age = 0xFFFFFFF;
-    int read_order = 0;
-    for(int i = 0; i < CATEGORYCOUNT; i++) {
-#pragma HLS unroll
-        if(!empty[i]) {
-            orderT order;
-            int id;
-            std::tie(order, id) = id_by_category[i][read_index_by_category[i]];
-            orderT age = order - last_read; // explicit truncation so we can do a modulo subtraction.
-            if(age < youngest_age) {
-                youngest_age = age;
-                read_category = i;
-                read_id = id;
-                read_order = order;
-            }
+    if(!control.empty()) {
+        tm_control c = control.read();
+        switch(c.command) {
+        case SET_SCHEDULER: egress_scheduler.set_mode(hls::scheduler_mode(c.value.to_int())); break;
+        case SET_QUANTUM: egress_scheduler.set_quantum(c.category, c.value); break;
+        case SET_COST: egress_scheduler.set_cost(c.category, c.value); break;
+        case SET_SHAPER_RATE: shapers.set_rate(c.category, c.value); break;
+        case SET_SHAPER_BURST: shapers.set_burst(c.category, c.value); break;
+        case SET_POLICER_RATE: policers.set_rate(c.category, c.value); break;
+        case SET_POLICER_BURST: policers.set_burst(c.category, c.value); break;
+        case SET_POLICER_ACTION:
+            out_of_profile_mark[c.category] = c.value < CATEGORYCOUNT;
+            out_of_profile_category[c.category] = c.value;
+            break;
+        case SET_RED_MIN_THRESHOLD: aqm.set_min_threshold(c.category, c.value); break;
+        case SET_RED_MAX_THRESHOLD: aqm.set_max_threshold(c.category, c.value); break;
+        case SET_RED_MAX_PROBABILITY: aqm.set_max_probability(c.category, c.value); break;
+        case SET_RED_WEIGHT: aqm.set_weight(c.value); break;
+        case SET_ECN: ecn_enabled[c.category] = c.value != 0; break;
         }
     }
-    read_length = length[read_id];
 
     bool ingress_valid = !input_length_stream.empty();
     bool egress_valid = !output.full() && TEST_generate_output;
     //bool egress_valid = TEST_generate_output;
 
+    short input_length = 0;
+    ap_uint<8> tos = 0;
+    if(ingress_valid) {
+        input_length_stream >> input_length;
+        tos_stream >> tos;
+    }
+
+    // Unclear exactly what the requirements for this function is, but as a guess
+    // assume there are 8 categories of service corresponding to the upper 3 bits.
+    // We have one queue per category.
+    ap_uint<BitWidth<CATEGORYCOUNT>::Value> category = tos >> 5;
+
+    // Police the incoming packet.  Packets which are out of profile are
+    // moved to another category or dropped without being given a buffer.
+    bool enqueue = ingress_valid;
+    if(ingress_valid && !policers.consume(category, input_length)) {
+        if(out_of_profile_mark[category]) {
+            category = out_of_profile_category[category];
+        } else {
+            enqueue = false;
+        }
+#ifndef __SYNTHESIS__
+        std::cout << "Policing packet length=" << input_length << " from Category " << category << "\n";
+#endif
+    }
+
+    // Random early detection, based on the average number of bytes in the queue.
+    // Packets which are ECN-capable (with ECT(0), ECT(1) or CE in the
+    // lower 2 bits of tos) can be marked instead of dropped.
+    bool ecn_mark = false;
+    if(enqueue && aqm.congested(category, queued_bytes[category])) {
+        if(ecn_enabled[category] && tos(1, 0) != 0) {
+            ecn_mark = true;
+        } else {
+            enqueue = false;
+        }
+#ifndef __SYNTHESIS__
+        std::cout << (ecn_mark ? "Marking" : "Dropping") << " packet length=" << input_length << " from Category " << category << "\n";
+#endif
+    }
+
     bufferIDT write_id = -1;
     int drop_category = -1;
-    int drop_index = 0;
-    // This keeps track of which buffers have been put into circulation.
-    static int allocated_buffer = 0;
-    if(ingress_valid && !completed.empty()) {
-        write_id = completed.read();
+    // This keeps track of which buffers are in circulation.
+    static FifoAllocator<BUFFERCOUNT> buffers;
+    // Free a completed buffer and allocate a buffer ID to store the packet in,
+    // in the same operation.  If both happen, then the completed buffer is reused.
+    int free_id = -1;
+    if(!completed.empty()) {
+        free_id = completed.read();
+    }
+    int allocated_id = buffers.allocate_and_free(free_id, enqueue);
+    if(allocated_id >= 0) {
+        write_id = allocated_id;
 #ifndef __SYNTHESIS__
-        std::cout << "Using old ID " << write_id << "\n";
+        if(allocated_id == free_id) std::cout << "Using old ID " << write_id << "\n";
 #endif
-    } else if(ingress_valid && allocated_buffer < BUFFERCOUNT) {
-        // Allocate a buffer ID to store the packet in
-        write_id = allocated_buffer++;
-    } else if(ingress_valid) { // Failed to allocate a buffer.
+    } else if(enqueue) { // Failed to allocate a buffer.
 #ifndef __SYNTHESIS__
         std::cout << "Attempting to Reallocate..\n";
 #endif
-        // Drop a lowest priority packet and use its buffer id.
-        // (In this case, we choose to drop the oldest packet in the category,
-        // because that's relatively simple to implement)
-        int count = 0;
-        // Find the category with the lowest priority
-        for(int i = 0; i < CATEGORYCOUNT; i++) {
-#pragma HLS unroll
-            if(!empty[i]) {
-                drop_category = i;
-                drop_index = read_index_by_category[i];
-                break;
-            }
-        }
+        // Drop a packet and use its buffer id.  The scheduler chooses
+        // the category, and we drop the oldest packet in the category,
+        // because that's relatively simple to implement.  If the incoming
+        // packet has lower priority than any queued packet, or all the
+        // buffers are waiting to be sent, then drop it instead.
+        drop_category = egress_scheduler.victim(nonempty, queued_bytes, category);
         if(drop_category >= 0) {
-            orderT order;
-            std::tie(order, write_id) =
-                id_by_category[drop_category][drop_index];
+            write_id = head[drop_category].id;
 #ifndef __SYNTHESIS__
             std::cout << "Reallocating ID " << write_id << "\n";
 #endif
         } else {
-            assert("No buffers to allocate and none to recover" && false);
+            enqueue = false;
+#ifndef __SYNTHESIS__
+            std::cout << "Dropping packet length=" << input_length << " from Category " << category << "\n";
+#endif
         }
     }
 
-    short input_length = 0;
-    ap_uint<6> diffserv = 0;
-    if(ingress_valid) {
-        input_length_stream >> input_length;
-        diffserv_stream >> diffserv;
+    // Egress path.  Note that the ingress and egress paths are almost always
+    // independent, so that they can be scheduled in parallel.  However, only one
+    // packet can be removed from the queues in each call, since removing a packet
+    // reads link.  If we have an ingress packet and we've run out of buffers to
+    // allocate, then the oldest packet of the category chosen by the scheduler is
+    // dropped and no packet is sent.  Since this only happens when the buffers are full,
+    // there will be a packet to send in the next call.
+    // Additionally, we don't send a packet if the output queue is full, and we
+    // only send from categories which have enough shaping tokens for the packet.
+    ap_uint<16> head_length[CATEGORYCOUNT];
+    bool eligible[CATEGORYCOUNT];
+    for(int i = 0; i < CATEGORYCOUNT; i++) {
+#pragma HLS unroll
+        head_length[i] = head[i].length;
+        eligible[i] = nonempty[i] && shapers.conforms(i, head_length[i]);
     }
-
-    // Unclear exactly what the requirements for this function is, but as a guess
-    // assume there are 8 categories of service corresponding to the upper 3 bits.
-    // We have one queue per category.
-    ap_uint<BitWidth<CATEGORYCOUNT>::Value> category = diffserv >> 3;
-
-    if(ingress_valid) {
-        id_by_category[category][write_index_by_category[category]++] = std::make_pair(last_written++, write_id);
-#ifndef __SYNTHESIS__
-        std::cout << "Writing ID " << write_id << " length=" << input_length << " from Category " << category << "\n";
-#endif
-        assert(write_index_by_category[category] < BUFFERCOUNT);
-        assert(write_index_by_category[category] != read_index_by_category[category]); // There should be enough size in id_by_category that they can never fill up.
+    int read_category = egress_scheduler.schedule(nonempty, eligible, head_length,
+                                                  egress_valid && drop_category < 0);
+    if(read_category >= 0) shapers.consume(read_category, head_length[read_category]);
+    shapers.tick();
+    policers.tick();
+    queue_entry read_entry;
+    if(read_category >= 0) read_entry = head[read_category];
+    if(drop_category >= 0) egress_scheduler.drop(drop_category);
+    int dequeue_category = (drop_category >= 0) ? drop_category : read_category;
+
+    // Remove the head of the queue.  This happens before appending the
+    // incoming packet, so that a queue with one entry can be both read and
+    // written in the same call.  The head and tail of the queue are selected
+    // first, so that link is read at most once.
+    bool dequeue = dequeue_category >= 0;
+    bufferIDT dequeue_id = 0;
+    bool dequeue_last = false;
+    if(dequeue) {
+        dequeue_id = head[dequeue_category].id;
+        dequeue_last = dequeue_id == tail[dequeue_category];
     }
-    length[write_id] = input_length;
-
-    // Egress path.  Note that the above two cases are almost always independent, so
-    // that they can be scheduled in parallel.  However there is an occasional hazard
-    // if we have an ingress packet and an egress packet and we've run out of buffers
-    // to allocate and the buffer that we want to reuse is also the one we want to send.
-    // In this case we reallocate the buffer for the ingress path and discard the old
-    // buffer instead of forwarding it.
-    // Additionally, we don't send a packet if the output queue is full.
-    if(!egress_valid || ingress_valid && (drop_category == read_category)) {
-        read_category = -1;
+    queue_entry next;
+    if(dequeue && !dequeue_last) {
+        next = link[dequeue_id];
+        for(int d = LINK_FORWARD-1; d >= 0; d--) {
+#pragma HLS unroll
+            if(dequeue_id == last_link_id[d]) next = last_link[d];
+        }
     }
-
-    // Handle updating the read index;
     for(int i = 0; i < CATEGORYCOUNT; i++) {
 #pragma HLS unroll
-        if(i == read_category || i == drop_category) {
-            read_index_by_category[i]++;
+        if(i == dequeue_category) {
+            queued_bytes[i] -= head[i].length;
+            if(dequeue_last) {
+                nonempty[i] = false;
+            } else {
+                head[i] = next;
+            }
+        }
+    }
+
+    if(enqueue) {
+        queue_entry entry;
+        entry.id = write_id;
+        entry.length = input_length;
+        // Append the incoming packet to the tail of the queue, writing link
+        // at most once.
+        if(nonempty[category]) {
+            bufferIDT enqueue_tail = tail[category];
+            link[enqueue_tail] = entry;
+            for(int d = LINK_FORWARD-1; d > 0; d--) {
+#pragma HLS unroll
+                last_link_id[d] = last_link_id[d-1];
+                last_link[d] = last_link[d-1];
+            }
+            last_link_id[0] = enqueue_tail;
+            last_link[0] = entry;
+        }
+        for(int i = 0; i < CATEGORYCOUNT; i++) {
+#pragma HLS unroll
+            if(i == category) {
+                if(!nonempty[i]) {
+                    head[i] = entry;
+                    nonempty[i] = true;
+                }
+                tail[i] = write_id;
+                queued_bytes[i] += input_length;
+            }
         }
+#ifndef __SYNTHESIS__
+        std::cout << "Writing ID " << write_id << " length=" << input_length << " from Category " << category << "\n";
+#endif
     }
+
     if(read_category >= 0) {
 #ifndef __SYNTHESIS__
-        std::cout << "Reading ID " << read_id << " length=" << read_length << " from Category " << read_category << "\n";
+        std::cout << "Reading ID " << read_entry.id << " length=" << read_entry.length << " from Category " << read_category << "\n";
 #endif
-        last_read = read_order;
-        output << read_id;
-        outputLength << read_length;
+        output << read_entry.id;
+        outputLength << read_entry.length;
     }
     if(ingress_valid) {
         buffer_id_stream << write_id;
+        ecn_mark_stream << ecn_mark;
     }
 #ifndef __SYNTHESIS__
-    // std::cout << "Read@";
-    // for(int i = 0; i < CATEGORYCOUNT; i++) {
-    //     std::cout << " " << read_index_by_category[i];
-    // }
-    // std::cout << "\n";
-    // std::cout << "Write@";
-    // for(int i = 0; i < CATEGORYCOUNT; i++) {
-    //     std::cout << " " << write_index_by_category[i];
-    // }
-    // std::cout << "\n";
     for(int i = 0; i < CATEGORYCOUNT; i++) {
-        std::cout << "Category " << i << " (" << read_index_by_category[i] << " " << write_index_by_category[i] << ")";
-        for(int j = read_index_by_category[i]; j < write_index_by_category[i]; j++) {
-            orderT order;
-            bufferIDT id;
-            std::tie(order, id) = id_by_category[i][j];
-            std::cout << " " << order << "@" << id;
+        std::cout << "Category " << i;
+        if(nonempty[i]) {
+            queue_entry entry = head[i];
+            std::cout << " " << entry.id;
+            while(entry.id != tail[i]) {
+                entry = link[entry.id];
+                std::cout << " " << entry.id;
+            }
         }
         std::cout << "\n";
     }
@@ -242,17 +364,17 @@ void ingress(hls::stream<StreamType> &input,    // input
              hls::stream<StreamType> &internal,    // output
              hls::stream<short> &input_length_stream1, // output
              hls::stream<short> &input_length_stream2, // output
-             hls::stream<ap_uint<6> > &diffserv_stream // output
+             hls::stream<ap_uint<8> > &tos_stream // output
              ) {
 #pragma HLS interface port=return ap_ctrl_none
 #pragma HLS interface port=input axis
 #pragma HLS interface port=internal axis
 #pragma HLS interface port=input_length_stream1 axis
 #pragma HLS interface port=input_length_stream2 axis
-#pragma HLS interface port=diffserv_stream axis
+#pragma HLS interface port=tos_stream axis
     
     short input_length;
-    ap_uint<6> diffserv;
+    ap_uint<8> tos;
 
     // Define the structure of the packets we're interested in.  Generally speaking we
     // have parallel access to the 'header' portion (the values are stored in registers),
@@ -261,29 +383,29 @@ void ingress(hls::stream<StreamType> &input,    // input
     ipv4_hdr<Packet> ih(p);
     ethernet_hdr<ipv4_hdr<Packet> > eh(ih);
     eh.deserialize(input);
-    diffserv = ih.diffserv.get() >> 2; // Drop the ECN field.
+    tos = ih.diffserv.get(); // The DSCP and ECN fields.
     input_length = eh.data_length();
     eh.serialize(internal);
     input_length_stream1 << input_length;
     input_length_stream2 << input_length;
-    diffserv_stream << diffserv;
+    tos_stream << tos;
 }
 
 void ingress_new(hls::stream<StreamType> &input,    // input
              hls::stream<StreamType> &internal,    // output
              hls::stream<short> &input_length_stream1, // output
              hls::stream<short> &input_length_stream2, // output
-             hls::stream<ap_uint<6> > &diffserv_stream // output
+             hls::stream<ap_uint<8> > &tos_stream // output
              ) {
 #pragma HLS interface port=return ap_ctrl_none
 #pragma HLS interface port=input axis
 #pragma HLS interface port=internal axis
 #pragma HLS interface port=input_length_stream1 axis
 #pragma HLS interface port=input_length_stream2 axis
-#pragma HLS interface port=diffserv_stream axis
+#pragma HLS interface port=tos_stream axis
 
     short input_length;
-    ap_uint<6> diffserv;
+    ap_uint<8> tos;
 
     // Define the structure of the packets we're interested in.  Generally speaking we
     // have parallel access to the 'header' portion (the values are stored in registers),
@@ -295,43 +417,84 @@ void ingress_new(hls::stream<StreamType> &input,    // input
     ipv4::header ih;
     reader.get(ih);
 
-    diffserv = ih.get<ipv4::diffserv>() >> 2; // Drop the ECN field.
+    tos = ih.get<ipv4::diffserv>(); // The DSCP and ECN fields.
     input_length = eh.data_length();
     input_length_stream1 << input_length;
     input_length_stream2 << input_length;
-    diffserv_stream << diffserv;
+    tos_stream << tos;
 
     writer.put(eh);
     writer.put(ih);
     writer.put_rest(reader);
 }
+// Return the IPv4 header checksum after the TOS byte changes from old_tos
+// to new_tos, using the incremental update from RFC 1624:
+// HC' = ~(~HC + ~m + m').  The version byte in the same 16-bit word as
+// the TOS byte does not change, so it cancels out.
+ap_uint<16> update_ip_checksum(ap_uint<16> checksum, ap_uint<8> old_tos, ap_uint<8> new_tos) {
+#pragma HLS inline
+    IPChecksum<16> sum(checksum);
+    sum.subtract(old_tos);
+    sum.add(new_tos);
+    return sum.get();
+}
+
 void ingress_writer(hls::stream<StreamType> &internal,    // input
                     hls::stream<short> &input_length_stream, // input
                     hls::stream<bufferIDT> &buffer_id_stream, // input
-             ap_uint<8*BYTESPERCYCLE> buffer_storage[2048/BYTESPERCYCLE][BUFFERCOUNT] // written
+                    hls::stream<bool> &ecn_mark_stream, // input
+             ap_uint<8*BYTESPERCYCLE> buffer_storage[BUFFERCOUNT][2048/BYTESPERCYCLE] // written
              ) {
 #pragma HLS interface port=return ap_ctrl_none
 #pragma HLS interface port=internal axis
 #pragma HLS interface port=input_length_stream axis
 #pragma HLS interface port=buffer_id_stream axis
-#pragma HLS interface port=buffer_storage bram
+#pragma HLS interface port=ecn_mark_stream axis
+    // The depth is BUFFERCOUNT*2048/BYTESPERCYCLE.
+#pragma HLS interface port=buffer_storage m_axi offset=off depth=1048576
+    // The byte offsets of the IPv4 TOS byte and header checksum, following
+    // an ethernet header.  The checksum must not span two beats.
+    const int TOS_OFFSET = 15;
+    const int CHECKSUM_OFFSET = 24;
+    const int TOS_LANE = TOS_OFFSET % BYTESPERCYCLE;
+    const int CHECKSUM_LANE = CHECKSUM_OFFSET % BYTESPERCYCLE;
     bufferIDT buffer_id;
     buffer_id_stream >> buffer_id;
+    bool ecn_mark;
+    ecn_mark_stream >> ecn_mark;
     short input_length;
     input_length_stream >> input_length;
-    // Copy the packet to the external buffer.
+    // Copy the packet to the external buffer.  If the packet is marked,
+    // then set the ECN field to congestion experienced.
     StreamType t;
+    ap_uint<8> old_tos = 0;
+    ap_uint<8> new_tos = 0;
  write_loop:
     for(int i = 0; i < input_length/BYTESPERCYCLE; i++) {
 #pragma HLS pipeline II=1
         internal >> t;
-        buffer_storage[i][buffer_id] = t.data;
+        ap_uint<8*BYTESPERCYCLE> data = t.data;
+        if(ecn_mark && i == TOS_OFFSET/BYTESPERCYCLE) {
+            old_tos = data(8*TOS_LANE+7, 8*TOS_LANE);
+            new_tos = old_tos | 0x3;
+            data(8*TOS_LANE+7, 8*TOS_LANE) = new_tos;
+        }
+        if(ecn_mark && i == CHECKSUM_OFFSET/BYTESPERCYCLE) {
+            // The checksum is in network byte order.
+            ap_uint<16> checksum;
+            checksum(15, 8) = data(8*CHECKSUM_LANE+7, 8*CHECKSUM_LANE);
+            checksum(7, 0) = data(8*CHECKSUM_LANE+15, 8*CHECKSUM_LANE+8);
+            checksum = update_ip_checksum(checksum, old_tos, new_tos);
+            data(8*CHECKSUM_LANE+7, 8*CHECKSUM_LANE) = checksum(15, 8);
+            data(8*CHECKSUM_LANE+15, 8*CHECKSUM_LANE+8) = checksum(7, 0);
+        }
+        if(buffer_id >= 0) buffer_storage[buffer_id][i] = data;
     }
 }
 
 void egress(hls::stream<bufferIDT> &buffer_id_stream, // input
             hls::stream<short> &length_stream,    // input
-            ap_uint<8*BYTESPERCYCLE> buffer_storage[2048/BYTESPERCYCLE][BUFFERCOUNT], // read
+            ap_uint<8*BYTESPERCYCLE> buffer_storage[BUFFERCOUNT][2048/BYTESPERCYCLE], // read
             hls::stream<bufferIDT> &completed, // output
             hls::stream<StreamType> &output   // output
             ) {
@@ -340,7 +503,8 @@ void egress(hls::stream<bufferIDT> &buffer_id_stream, // input
 #pragma HLS interface port=length_stream axis
 #pragma HLS interface port=completed axis
 #pragma HLS interface port=output axis
-#pragma HLS interface port=buffer_storage bram
+    // The depth is BUFFERCOUNT*2048/BYTESPERCYCLE.
+#pragma HLS interface port=buffer_storage m_axi offset=off depth=1048576
     
     bufferIDT buffer_id;
     buffer_id_stream >> buffer_id;
@@ -351,7 +515,7 @@ void egress(hls::stream<bufferIDT> &buffer_id_stream, // input
  write_loop:
     for(int i = 0; i < length/BYTESPERCYCLE; i++) {
 #pragma HLS pipeline II=1
-        t.data = buffer_storage[i][buffer_id];
+        t.data = buffer_storage[buffer_id][i];
         t.keep = -1; // FIXME: generate_keep
         output << t;
     }
@@ -360,10 +524,11 @@ void egress(hls::stream<bufferIDT> &buffer_id_stream, // input
 
 void process_packet(hls::stream<StreamType> &input,    // input
                     hls::stream<bufferIDT> &completed, // input
+                    hls::stream<tm_control> &control, // input
                     hls::stream<bufferIDT> &output,    // output
                     hls::stream<short> &outputLength,    // output
                     //Packet buffer_storage[BUFFERCOUNT] // Each buffer is 2Kbytes, assuming 1500 byte MTU.
-                    ap_uint<8*BYTESPERCYCLE> buffer_storage[2048/BYTESPERCYCLE][BUFFERCOUNT] // Each buffer is 2Kbytes, assuming 1500 byte MTU.
+                    ap_uint<8*BYTESPERCYCLE> buffer_storage[BUFFERCOUNT][2048/BYTESPERCYCLE] // Each buffer is 2Kbytes, assuming 1500 byte MTU.
                     ) {
     #pragma HLS dataflow
 
@@ -373,14 +538,15 @@ void process_packet(hls::stream<StreamType> &input,    // input
     hls::stream<short> IoutputLength("IoutputLength");
     hls::stream<short> input_length_stream1("input_length_stream1"); // input
     hls::stream<short> input_length_stream2("input_length_stream2"); // input
-    hls::stream<ap_uint<6> > diffserv_stream("diffserv_stream"); // input
+    hls::stream<ap_uint<8> > tos_stream("tos_stream"); // input
     hls::stream<bufferIDT> buffer_id_stream("buffer_id_stream"); // input
-    ingress(input, internal, input_length_stream1, input_length_stream2, diffserv_stream);
+    hls::stream<bool> ecn_mark_stream("ecn_mark_stream"); // input
+    ingress(input, internal, input_length_stream1, input_length_stream2, tos_stream);
 
-    priority_queue_manager(input_length_stream2, diffserv_stream, buffer_id_stream,
-                           completed, Ioutput, IoutputLength);
+    priority_queue_manager(input_length_stream2, tos_stream, buffer_id_stream, ecn_mark_stream,
+                           completed, control, Ioutput, IoutputLength);
 
-    ingress_writer(internal, input_length_stream1, buffer_id_stream, buffer_storage);
+    ingress_writer(internal, input_length_stream1, buffer_id_stream, ecn_mark_stream, buffer_storage);
 
 
 
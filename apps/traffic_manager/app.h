@@ -25,27 +25,67 @@ limitations under the License.
 
 #define BYTESPERCYCLE 8
 typedef ap_axiu<8*BYTESPERCYCLE,1,1,1> StreamType;
-const static int BUFFERCOUNT = 16;
+// The priority_queue_manager keeps one linked list entry for each buffer,
+// so this can be scaled to 4K-64K buffers.  The buffers themselves take
+// 2 Kbytes each (8 Mbytes for 4K buffers), so they are kept in external
+// memory, with each buffer stored contiguously so that it can be
+// accessed in bursts.
+const static int BUFFERCOUNT = 4096;
 const static int CATEGORYCOUNT = 8;
 typedef ap_int<BitWidth<BUFFERCOUNT>::Value> bufferIDT;
-typedef ap_uint<UnsignedBitWidth<BUFFERCOUNT>::Value> indexT;
-typedef ap_uint<UnsignedBitWidth<2*BUFFERCOUNT>::Value> orderT; // What is this bound?  I think it's probably bigger than 2*BUFFERCOUNT
+
+// Commands which configure the priority_queue_manager at runtime.
+enum tm_command {
+    SET_SCHEDULER, // value is an hls::scheduler_mode.
+    SET_QUANTUM, // value is the deficit round robin quantum of category, in bytes.
+    SET_COST, // value is the weighted fair queueing cost per byte of category.
+    // Rates are in bytes per cycle with 16 fractional bits, and bursts are in bytes.
+    // A rate of zero disables shaping or policing of the category.
+    SET_SHAPER_RATE,
+    SET_SHAPER_BURST,
+    SET_POLICER_RATE,
+    SET_POLICER_BURST,
+    // value is the category that out-of-profile packets are moved to, or
+    // CATEGORYCOUNT or more if they are dropped.
+    SET_POLICER_ACTION,
+    // Random early detection thresholds are in bytes, and the probability
+    // is in units of 2^-16.  A maximum threshold of zero disables RED.
+    SET_RED_MIN_THRESHOLD,
+    SET_RED_MAX_THRESHOLD,
+    SET_RED_MAX_PROBABILITY,
+    SET_RED_WEIGHT, // value is the averaging weight shift, for all categories.
+    SET_ECN // if value is nonzero, then ECN-capable packets are marked instead of dropped.
+};
+struct tm_control {
+    ap_uint<4> command;
+    ap_uint<BitWidth<CATEGORYCOUNT>::Value> category;
+    ap_uint<32> value;
+};
 
 void process_packet(hls::stream<StreamType> &input,    // input
                     hls::stream<bufferIDT> &completed, // input
+                    hls::stream<tm_control> &control, // input
                     hls::stream<bufferIDT> &output,    // output
                     hls::stream<short> &outputLength,    // output
                     //Packet buffer_storage[BUFFERCOUNT] // Each buffer is 2Kbytes
-                    ap_uint<8*BYTESPERCYCLE> buffer_storage[2048/BYTESPERCYCLE][BUFFERCOUNT] // Each buffer is 2Kbytes, assuming 1500 byte MTU.
+                    ap_uint<8*BYTESPERCYCLE> buffer_storage[BUFFERCOUNT][2048/BYTESPERCYCLE] // Each buffer is 2Kbytes, assuming 1500 byte MTU.
                     );
 
 void priority_queue_manager(hls::stream<short> &input_length_stream, // input
-                            hls::stream<ap_uint<6> > &diffserv_stream, // input
+                            hls::stream<ap_uint<8> > &tos_stream, // input
                             hls::stream<bufferIDT> &buffer_id_stream, // output
+                            hls::stream<bool> &ecn_mark_stream, // output
                             hls::stream<bufferIDT> &completed, // input
+                            hls::stream<tm_control> &control, // input
                             hls::stream<bufferIDT> &output,    // output
                             hls::stream<short> &outputLength    // output
                             );
+void ingress_writer(hls::stream<StreamType> &internal,    // input
+                    hls::stream<short> &input_length_stream, // input
+                    hls::stream<bufferIDT> &buffer_id_stream, // input
+                    hls::stream<bool> &ecn_mark_stream, // input
+                    ap_uint<8*BYTESPERCYCLE> buffer_storage[BUFFERCOUNT][2048/BYTESPERCYCLE] // written
+                    );
 extern bool TEST_generate_output;
 
 #endif
@@ -148,13 +148,14 @@ void test_sink(hls::stream<StreamType> &output) {
 }
 
 #ifdef MAIN
-static ap_uint<8*BYTESPERCYCLE> buffer_storage[2048/BYTESPERCYCLE][BUFFERCOUNT];
+static ap_uint<8*BYTESPERCYCLE> buffer_storage[BUFFERCOUNT][2048/BYTESPERCYCLE];
 //Packet buffer_storage[BUFFERCOUNT];
 int main(int argc, char* argv[])
 {
 	int result;
     hls::stream<StreamType> input;
     hls::stream<bufferIDT> completed;
+    hls::stream<tm_control> control;
     hls::stream<bufferIDT> output;
     hls::stream<short> outputLength;
 
@@ -198,7 +199,7 @@ int main(int argc, char* argv[])
         }
     }
     
-    process_packet(input, completed, output, outputLength, buffer_storage);
+    process_packet(input, completed, control, output, outputLength, buffer_storage);
     std::cout << "output:";
     dumpDataBeats(output);
     
@@ -243,7 +244,7 @@ int main(int argc, char* argv[])
         }
     }
 
-    process_packet(input, completed, output, outputLength, buffer_storage);
+    process_packet(input, completed, control, output, outputLength, buffer_storage);
     std::cout << "output:";
     dumpDataBeats(output);
     }
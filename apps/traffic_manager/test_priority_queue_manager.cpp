@@ -0,0 +1,235 @@
+/*
+Copyright (c) 2016-2018, Xilinx, Inc.
+All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include <iostream>
+#include <deque>
+#include <map>
+
+#include "app.h"
+#include "scheduler.h"
+
+hls::stream<short> input_length;
+hls::stream<ap_uint<8> > tos;
+hls::stream<bufferIDT> buffer_id;
+hls::stream<bool> ecn_mark;
+hls::stream<bufferIDT> completed;
+hls::stream<tm_control> control;
+hls::stream<bufferIDT> output;
+hls::stream<short> output_length;
+
+// Call the queue manager once, discarding its trace of the queues.
+void run() {
+    std::streambuf *old = std::cout.rdbuf(0);
+    priority_queue_manager(input_length, tos, buffer_id, ecn_mark, completed, control, output, output_length);
+    std::cout.rdbuf(old);
+}
+
+void configure(int command, int category, int value) {
+    tm_control c;
+    c.command = command;
+    c.category = category;
+    c.value = value;
+    control.write(c);
+    run();
+}
+
+struct arrival {
+    short length;
+    int category;
+    bool ect;
+};
+
+static ap_uint<8*BYTESPERCYCLE> buffer_storage[BUFFERCOUNT][2048/BYTESPERCYCLE];
+
+// Return the IPv4 header checksum of packet, computed over the whole header
+// with the checksum field taken as zero.
+unsigned ip_checksum(const unsigned char *packet) {
+    const int IP = 14;
+    unsigned sum = 0;
+    for(int i = 0; i < 20; i += 2) {
+        if(i != 10) sum += (packet[IP+i] << 8) | packet[IP+i+1];
+    }
+    while(sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum & 0xFFFF;
+}
+
+// Write random IPv4 packets with different ECN fields to a buffer, marking
+// some of them, and check that marked packets have congestion experienced
+// set and a header checksum which matches a full recomputation, and that
+// no other bytes change.
+void check_ecn_marking() {
+    const int LENGTH = 64;
+    for(int k = 0; k < 1000; k++) {
+        unsigned char packet[LENGTH];
+        for(int i = 0; i < LENGTH; i++) packet[i] = rand();
+        packet[12] = 0x08;
+        packet[13] = 0x00;
+        packet[14] = 0x45;
+        int checksum = ip_checksum(packet);
+        packet[24] = checksum >> 8;
+        packet[25] = checksum;
+        bool mark = rand() % 2;
+        hls::stream<StreamType> internal;
+        hls::stream<short> length;
+        hls::stream<bufferIDT> id;
+        hls::stream<bool> ecn;
+        for(int i = 0; i < LENGTH/BYTESPERCYCLE; i++) {
+            StreamType t;
+            for(int j = 0; j < BYTESPERCYCLE; j++) {
+                t.data(8*j+7, 8*j) = packet[i*BYTESPERCYCLE+j];
+            }
+            t.keep = -1;
+            t.last = i == LENGTH/BYTESPERCYCLE-1;
+            internal.write(t);
+        }
+        length.write(LENGTH);
+        id.write(k % BUFFERCOUNT);
+        ecn.write(mark);
+        ingress_writer(internal, length, id, ecn, buffer_storage);
+
+        unsigned char stored[LENGTH];
+        for(int i = 0; i < LENGTH; i++) {
+            stored[i] = buffer_storage[k % BUFFERCOUNT][i/BYTESPERCYCLE](8*(i%BYTESPERCYCLE)+7, 8*(i%BYTESPERCYCLE));
+        }
+        if(mark) {
+            assert((stored[15] & 0x3) == 0x3);
+            packet[15] |= 0x3;
+        }
+        assert(((stored[24] << 8) | stored[25]) == ip_checksum(stored));
+        for(int i = 0; i < LENGTH; i++) {
+            if(i != 24 && i != 25) assert(stored[i] == packet[i]);
+        }
+    }
+}
+
+// Send random packets through the queue manager while the egress runs at
+// different rates, checking that each buffer is in at most one queue, that
+// lengths are returned with their buffers, that each category is sent in
+// arrival order, and that packets are only dropped from the head of a queue.
+// Category 7 is shaped, category 6 is policed and categories 4 and 5 use
+// RED, with ECN marking in category 5.
+void check_queues() {
+    configure(SET_SHAPER_RATE, 7, 1 << 14); // 0.25 bytes per cycle.
+    configure(SET_SHAPER_BURST, 7, 2000);
+    configure(SET_POLICER_RATE, 6, 1 << 12);
+    configure(SET_POLICER_BURST, 6, 2000);
+    configure(SET_POLICER_ACTION, 6, CATEGORYCOUNT);
+    for(int c = 4; c <= 5; c++) {
+        configure(SET_RED_MIN_THRESHOLD, c, 2000);
+        configure(SET_RED_MAX_THRESHOLD, c, 20000);
+        configure(SET_RED_MAX_PROBABILITY, c, 10000);
+    }
+    configure(SET_ECN, 5, 1);
+
+    // The queue of buffer ids in each category, and the length and
+    // category of each queued buffer.
+    std::deque<int> queues[CATEGORYCOUNT];
+    std::map<int, short> lengths;
+    std::map<int, int> categories;
+    std::deque<int> sent;
+    int policed = 0, red_dropped = 0, marked = 0;
+    int arrivals_dropped = 0, queued_dropped = 0;
+    long shaped_bytes = 0;
+    const int CALLS = 20000;
+    const hls::scheduler_mode modes[] = {
+        hls::STRICT_PRIORITY, hls::DEFICIT_ROUND_ROBIN, hls::WEIGHTED_FAIR_QUEUEING
+    };
+    for(int m = 0; m < 3; m++) {
+        configure(SET_SCHEDULER, 0, modes[m]);
+        bool strict = modes[m] == hls::STRICT_PRIORITY;
+        for(int i = 0; i < CALLS; i++) {
+            // Run the egress quickly, then slowly so that the buffers fill up.
+            TEST_generate_output = (i < CALLS/4) ? rand() % 3 != 0 : rand() % 32 == 0;
+            bool arriving = rand() % 2;
+            arrival a;
+            if(arriving) {
+                a.length = 64 + rand() % 1000;
+                a.category = rand() % CATEGORYCOUNT;
+                int ecn = rand() % 4;
+                a.ect = ecn != 0;
+                input_length.write(a.length);
+                tos.write((a.category << 5) | ecn);
+            }
+            if(!sent.empty() && rand() % 2) {
+                completed.write(sent.front());
+                sent.pop_front();
+            }
+            run();
+
+            if(arriving) {
+                int id = buffer_id.read();
+                bool mark = ecn_mark.read();
+                assert(id >= -1 && id < BUFFERCOUNT);
+                if(mark) {
+                    assert(a.category == 5 && a.ect);
+                    marked++;
+                }
+                if(id < 0) {
+                    if(a.category == 6) {
+                        policed++;
+                    } else if(a.category == 4 || (a.category == 5 && !a.ect)) {
+                        red_dropped++;
+                    } else {
+                        // Only an arriving packet of lower priority than
+                        // every queued packet is dropped.
+                        assert(strict);
+                        for(int c = 0; c <= a.category; c++) assert(queues[c].empty());
+                        arrivals_dropped++;
+                    }
+                } else {
+                    if(lengths.count(id)) {
+                        // The buffer was taken from the head of a queue.
+                        int c = categories[id];
+                        assert(queues[c].front() == id);
+                        if(strict) assert(c <= a.category);
+                        queues[c].pop_front();
+                        queued_dropped++;
+                    }
+                    lengths[id] = a.length;
+                    categories[id] = a.category;
+                    queues[a.category].push_back(id);
+                }
+            }
+            assert(buffer_id.empty());
+
+            while(!output.empty()) {
+                int id = output.read();
+                short length = output_length.read();
+                assert(lengths.count(id) && lengths[id] == length);
+                int c = categories[id];
+                assert(queues[c].front() == id);
+                queues[c].pop_front();
+                if(c == 7) shaped_bytes += length;
+                lengths.erase(id);
+                sent.push_back(id);
+            }
+        }
+    }
+    std::cout << policed << " policed, " << red_dropped << " dropped by RED, "
+              << marked << " marked, " << shaped_bytes << " shaped bytes sent\n";
+    std::cout << arrivals_dropped << " arrivals dropped, " << queued_dropped << " queued packets dropped\n";
+    assert(policed > 0 && red_dropped > 0 && marked > 0);
+    assert(shaped_bytes <= 3*CALLS/4 + 2000);
+    assert(arrivals_dropped > 0 && queued_dropped > 0);
+}
+
+int main(int argc, char *argv[]) {
+    check_ecn_marking();
+    check_queues();
+}